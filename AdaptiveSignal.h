@@ -0,0 +1,419 @@
+#ifndef ADAPTIVESIGNAL_H
+#define ADAPTIVESIGNAL_H
+
+#include "Signals.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** Signal whose slot storage follows its fan-out. Slots are DirectSlots addressed
+  by a handle, the slot's logical index, which every layout maps to the same slot:
+  - inline_slot: handle 0 only, stored in the signal object itself
+  - small_array: handles below smallCapacity, one heap block and a bitmap word
+  - segmented: blocks of 64 slots, each with its own bitmap word, that never move
+  The layout grows when a handle doesn't fit anymore and shrinks (with hysteresis)
+  once the remaining handles fit a smaller one, so handles stay valid across all
+  transitions. Freed handles are reused lowest first to keep the indices compact.
+  Slots may connect, disconnect and block (themselves or others) while being notified,
+  emission looks the next slot up in whatever layout is current **/
+template<typename... args>
+class AdaptiveSignal
+{
+  public:
+    /** connection handle **/
+    using handle = unsigned;
+
+    /** storage layout **/
+    enum class Layout
+    {
+      inline_slot,
+      small_array,
+      segmented
+    };
+
+    /** number of slots of the small array layout **/
+    static const unsigned smallCapacity = 8;
+
+    /** constructor **/
+    AdaptiveSignal()
+      : layout_(Layout::inline_slot),
+      bits_(0),
+      changes_(0),
+      inline_{nullptr, nullptr},
+      count_(0)
+    {
+    }
+
+    /** connect a non-static member function **/
+    template<typename T, typename ReturnType>
+    handle connect(T& obj, ReturnType (T::*memFn)(args...))
+    {
+      return add(new ObjDelegate<T, ReturnType, args...>(obj, memFn));
+    }
+
+    /** connect a static member function or free function **/
+    template<typename ReturnType>
+    handle connect(ReturnType (*fn)(args...))
+    {
+      return add(new FnDelegate<ReturnType, args...>(fn));
+    }
+
+    /** disconnect. Handles that aren't connected are ignored **/
+    void disconnect(handle h)
+    {
+      if (!connected(h))
+      {
+        return;
+      }
+      setActive(h, false);
+      delegates_[h].reset();
+      blocked_[h] = false;
+      setFree(h, true);
+      count_--;
+      shrink();
+    }
+
+    /** is h connected? **/
+    bool connected(handle h) const
+    {
+      return h < delegates_.size() && delegates_[h];
+    }
+
+    /** stop notifying h until unblock(). Handles that aren't connected are ignored **/
+    void block(handle h)
+    {
+      if (connected(h))
+      {
+        blocked_[h] = true;
+        setActive(h, false);
+      }
+    }
+
+    /** notify h again. Handles that aren't connected are ignored **/
+    void unblock(handle h)
+    {
+      if (connected(h))
+      {
+        blocked_[h] = false;
+        setActive(h, true);
+      }
+    }
+
+    /** is h connected but blocked? **/
+    bool blocked(handle h) const
+    {
+      return h < blocked_.size() && blocked_[h];
+    }
+
+    /** number of connected slots, blocked or not **/
+    unsigned count() const
+    {
+      return count_;
+    }
+
+    /** current storage layout **/
+    Layout layout() const
+    {
+      return layout_;
+    }
+
+    /** notify all active slots in handle order **/
+    void operator()(args... a) const
+    {
+      switch (layout_)
+      {
+        case Layout::inline_slot:
+          if (bits_ != 0)
+          {
+            inline_(std::forward<args>(a)...);
+          }
+          return;
+        case Layout::small_array:
+          emitSmall(a...);
+          return;
+        default:
+          emitSegments(a...);
+      }
+    }
+
+    /** destructor **/
+    ~AdaptiveSignal()
+    {
+      for (Segment* s : segments_)
+      {
+        delete s;
+      }
+    }
+
+  private:
+    /** don't allow copy construction **/
+    AdaptiveSignal(const AdaptiveSignal& other);
+
+    /** don't allow copy assignment **/
+    AdaptiveSignal& operator= (AdaptiveSignal& other);
+
+    static const unsigned segmentSize = 64;
+    static const handle none = ~handle(0);
+
+    /** small array layout **/
+    struct Small
+    {
+      DirectSlot<args...> slots[smallCapacity];
+    };
+
+    /** block of the segmented layout **/
+    struct Segment
+    {
+      uint64_t bits;
+      DirectSlot<args...> slots[segmentSize];
+    };
+
+    /** notify the small array slots from a copy of the bitmap word. If a slot
+      (de)activates anything, the rest goes through emitFrom(), so slots see the
+      changes made by earlier ones **/
+    void emitSmall(args... a) const
+    {
+      const Small* small = small_.get();
+      uint32_t bits = bits_;
+      unsigned changes = changes_;
+      while (bits != 0)
+      {
+        handle h = handle(__builtin_ctz(bits));
+        bits &= bits - 1;
+        DirectSlot<args...> slot = small->slots[h];
+        slot(a...);
+        if (changes_ != changes)
+        {
+          emitFrom(h + 1, a...);
+          return;
+        }
+      }
+    }
+
+    /** notify the slots segment by segment, like emitSmall() **/
+    void emitSegments(args... a) const
+    {
+      unsigned changes = changes_;
+      for (size_t s = 0; s < segments_.size(); s++)
+      {
+        const Segment* segment = segments_[s];
+        uint64_t bits = segment->bits;
+        while (bits != 0)
+        {
+          unsigned i = unsigned(__builtin_ctzll(bits));
+          bits &= bits - 1;
+          DirectSlot<args...> slot = segment->slots[i];
+          slot(a...);
+          if (changes_ != changes)
+          {
+            emitFrom(handle(s * segmentSize + i + 1), a...);
+            return;
+          }
+        }
+      }
+    }
+
+    /** notify the active slots from handle h on, looking each one up in whatever
+      layout is current **/
+    void emitFrom(handle h, args... a) const
+    {
+      for (h = next(h); h != none; h = next(h + 1))
+      {
+        DirectSlot<args...> slot = slotAt(h); // the layout may change during the call
+        slot(a...);
+      }
+    }
+
+    /** first active handle at or after h, or none **/
+    handle next(handle h) const
+    {
+      if (layout_ == Layout::segmented)
+      {
+        for (size_t s = h / segmentSize; s < segments_.size(); s++, h = handle(s * segmentSize))
+        {
+          uint64_t bits = segments_[s]->bits & (~uint64_t(0) << (h % segmentSize));
+          if (bits != 0)
+          {
+            return handle(s * segmentSize) + handle(__builtin_ctzll(bits));
+          }
+        }
+        return none;
+      }
+      uint32_t bits = (h < 32) ? (bits_ & (~uint32_t(0) << h)) : 0;
+      return (bits != 0) ? handle(__builtin_ctz(bits)) : none;
+    }
+
+    DirectSlot<args...> slotAt(handle h) const
+    {
+      return const_cast<AdaptiveSignal*>(this)->slotRef(h);
+    }
+
+    DirectSlot<args...>& slotRef(handle h)
+    {
+      switch (layout_)
+      {
+        case Layout::inline_slot:
+          return inline_;
+        case Layout::small_array:
+          return small_->slots[h];
+        default:
+          return segments_[h / segmentSize]->slots[h % segmentSize];
+      }
+    }
+
+    /** handles that fit the current layout **/
+    handle capacity() const
+    {
+      switch (layout_)
+      {
+        case Layout::inline_slot:
+          return 1;
+        case Layout::small_array:
+          return smallCapacity;
+        default:
+          return ~handle(0);
+      }
+    }
+
+    void setActive(handle h, bool active)
+    {
+      changes_++;
+      if (layout_ == Layout::segmented)
+      {
+        uint64_t& bits = segments_[h / segmentSize]->bits;
+        uint64_t mask = uint64_t(1) << (h % segmentSize);
+        bits = active ? (bits | mask) : (bits & ~mask);
+      }
+      else
+      {
+        uint32_t mask = uint32_t(1) << h;
+        bits_ = active ? (bits_ | mask) : (bits_ & ~mask);
+      }
+    }
+
+    /** lowest handle that isn't connected **/
+    handle lowestFree() const
+    {
+      for (size_t w = 0; w < free_.size(); w++)
+      {
+        if (free_[w] != 0)
+        {
+          return handle(w * 64) + handle(__builtin_ctzll(free_[w]));
+        }
+      }
+      return handle(delegates_.size());
+    }
+
+    void setFree(handle h, bool free)
+    {
+      uint64_t mask = uint64_t(1) << (h % 64);
+      free_[h / 64] = free ? (free_[h / 64] | mask) : (free_[h / 64] & ~mask);
+    }
+
+    handle add(const AbstractDelegate<args...>* delegate)
+    {
+      handle h = lowestFree();
+      if (h == delegates_.size())
+      {
+        delegates_.emplace_back();
+        blocked_.push_back(false);
+        free_.resize((delegates_.size() + 63) / 64);
+      }
+      setFree(h, false);
+      delegates_[h].reset(delegate);
+      while (h >= capacity())
+      {
+        grow();
+      }
+      while (layout_ == Layout::segmented && h / segmentSize >= segments_.size())
+      {
+        segments_.push_back(new Segment());
+      }
+      slotRef(h) = delegate->slot();
+      setActive(h, true);
+      count_++;
+      return h;
+    }
+
+    /** move to the next larger layout **/
+    void grow()
+    {
+      if (layout_ == Layout::inline_slot)
+      {
+        small_.reset(new Small());
+        small_->slots[0] = inline_;
+        layout_ = Layout::small_array;
+        return;
+      }
+      Segment* s = new Segment();
+      s->bits = bits_;
+      for (handle h = 0; h < smallCapacity; h++)
+      {
+        s->slots[h] = small_->slots[h];
+      }
+      segments_.push_back(s);
+      small_.reset();
+      bits_ = 0;
+      layout_ = Layout::segmented;
+    }
+
+    /** move to a smaller layout if all connected handles fit. Blocked slots
+      count as connected. Leaves some room to avoid flapping between layouts **/
+    void shrink()
+    {
+      size_t end = delegates_.size();
+      while (end > 0 && !delegates_[end - 1])
+      {
+        end--;
+      }
+      delegates_.resize(end);
+      blocked_.resize(end);
+      free_.resize((end + 63) / 64);
+      if (end % 64 != 0)
+      {
+        free_.back() &= ~(~uint64_t(0) << (end % 64));
+      }
+      if (layout_ == Layout::segmented && count_ <= smallCapacity / 2 && end <= smallCapacity)
+      {
+        small_.reset(new Small());
+        const Segment* s = segments_[0];
+        for (handle h = 0; h < end; h++)
+        {
+          small_->slots[h] = s->slots[h];
+        }
+        bits_ = uint32_t(s->bits);
+        for (Segment* seg : segments_)
+        {
+          delete seg;
+        }
+        segments_.clear();
+        layout_ = Layout::small_array;
+      }
+      if (layout_ == Layout::small_array && end <= 1)
+      {
+        inline_ = small_->slots[0];
+        small_.reset();
+        layout_ = Layout::inline_slot;
+      }
+    }
+
+    /** hot: read by every emission **/
+    Layout layout_;
+    /** active bits of the inline and small array layouts **/
+    uint32_t bits_;
+    /** counts (de)activations, an emission falls back to emitFrom() when it changes **/
+    unsigned changes_;
+    DirectSlot<args...> inline_;
+    std::unique_ptr<Small> small_;
+    std::vector<Segment*> segments_;
+
+    /** cold: indexed by handle **/
+    std::vector<std::unique_ptr<const AbstractDelegate<args...>>> delegates_;
+    std::vector<bool> blocked_;
+    /** bit per handle below delegates_.size() that isn't connected **/
+    std::vector<uint64_t> free_;
+    unsigned count_;
+};
+
+#endif // ADAPTIVESIGNAL_H
@@ -0,0 +1,200 @@
+#ifndef BITMAPSIGNAL_H
+#define BITMAPSIGNAL_H
+
+#include "Signals.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/** Signal for large fan-out. Slots live in one contiguous array of DirectSlots,
+  their state in two bitmaps next to it: connected, and active (connected and not
+  blocked). Emission walks the set bits of the active bitmap with count-trailing-zeros,
+  so blocked and free slots are skipped without touching their memory. With AVX2,
+  runs of 256 inactive slots are skipped with a single test.
+  Slots may connect, disconnect and block (themselves or others) while being notified:
+  slots that are deactivated during an emission aren't called by it anymore, slots
+  that are connected during an emission may or may not be.
+  Handles are plain indices that are reused after disconnect **/
+template<typename... args>
+class BitmapSignal
+{
+  public:
+    /** connection handle **/
+    using handle = unsigned;
+
+    /** constructor **/
+    BitmapSignal()
+      : count_(0)
+    {
+    }
+
+    /** connect a non-static member function **/
+    template<typename T, typename ReturnType>
+    handle connect(T& obj, ReturnType (T::*memFn)(args...))
+    {
+      return add(new ObjDelegate<T, ReturnType, args...>(obj, memFn));
+    }
+
+    /** connect a static member function or free function **/
+    template<typename ReturnType>
+    handle connect(ReturnType (*fn)(args...))
+    {
+      return add(new FnDelegate<ReturnType, args...>(fn));
+    }
+
+    /** disconnect. Handles that aren't connected are ignored **/
+    void disconnect(handle h)
+    {
+      if (!connected(h))
+      {
+        return;
+      }
+      clear(connected_, h);
+      clear(active_, h);
+      delegates_[h].reset();
+      free_.push_back(h);
+      count_--;
+    }
+
+    /** is h connected? **/
+    bool connected(handle h) const
+    {
+      return h < slots_.size() && test(connected_, h);
+    }
+
+    /** stop notifying h until unblock(). Handles that aren't connected are ignored **/
+    void block(handle h)
+    {
+      if (connected(h))
+      {
+        clear(active_, h);
+      }
+    }
+
+    /** notify h again. Handles that aren't connected are ignored **/
+    void unblock(handle h)
+    {
+      if (connected(h))
+      {
+        set(active_, h);
+      }
+    }
+
+    /** is h connected but blocked? **/
+    bool blocked(handle h) const
+    {
+      return connected(h) && !test(active_, h);
+    }
+
+    /** number of connected slots, blocked or not **/
+    unsigned count() const
+    {
+      return count_;
+    }
+
+    /** notify all active slots in index order **/
+    void operator()(args... a) const
+    {
+      size_t w = 0;
+#if defined(__AVX2__)
+      for (; w + 4 <= active_.size(); w += 4)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&active_[w]));
+        if (_mm256_testz_si256(v, v))
+        {
+          continue;
+        }
+        for (size_t k = w; k < w + 4; k++)
+        {
+          emitWord(k, a...);
+        }
+      }
+#endif
+      for (; w < active_.size(); w++)
+      {
+        emitWord(w, a...);
+      }
+    }
+
+  private:
+    /** don't allow copy construction **/
+    BitmapSignal(const BitmapSignal& other);
+
+    /** don't allow copy assignment **/
+    BitmapSignal& operator= (BitmapSignal& other);
+
+    static const unsigned wordBits = 64;
+
+    /** notify the active slots of one bitmap word. The word is reloaded after every
+      call, so slots deactivated by a slot aren't called **/
+    void emitWord(size_t w, args... a) const
+    {
+      uint64_t bits = active_[w];
+      while (bits != 0)
+      {
+        unsigned i = unsigned(__builtin_ctzll(bits));
+        DirectSlot<args...> slot = slots_[w * wordBits + i]; // the array may grow during the call
+        slot(a...);
+        bits &= active_[w] & (~uint64_t(1) << i);
+      }
+    }
+
+    handle add(const AbstractDelegate<args...>* delegate)
+    {
+      handle h;
+      if (!free_.empty())
+      {
+        h = free_.back();
+        free_.pop_back();
+      }
+      else
+      {
+        h = handle(slots_.size());
+        slots_.push_back(DirectSlot<args...>());
+        delegates_.emplace_back();
+        if (h % wordBits == 0)
+        {
+          connected_.push_back(0);
+          active_.push_back(0);
+        }
+      }
+      delegates_[h].reset(delegate);
+      slots_[h] = delegate->slot();
+      set(connected_, h);
+      set(active_, h);
+      count_++;
+      return h;
+    }
+
+    static bool test(const std::vector<uint64_t>& bits, handle h)
+    {
+      return (bits[h / wordBits] >> (h % wordBits)) & 1;
+    }
+
+    static void set(std::vector<uint64_t>& bits, handle h)
+    {
+      bits[h / wordBits] |= uint64_t(1) << (h % wordBits);
+    }
+
+    static void clear(std::vector<uint64_t>& bits, handle h)
+    {
+      bits[h / wordBits] &= ~(uint64_t(1) << (h % wordBits));
+    }
+
+    /** hot: read by every emission **/
+    std::vector<uint64_t> active_;
+    std::vector<DirectSlot<args...>> slots_;
+
+    /** cold: only touched by connect, disconnect and block **/
+    std::vector<uint64_t> connected_;
+    std::vector<std::unique_ptr<const AbstractDelegate<args...>>> delegates_;
+    std::vector<handle> free_;
+    unsigned count_;
+};
+
+#endif // BITMAPSIGNAL_H
@@ -0,0 +1,203 @@
+#ifndef COWSIGNAL_H
+#define COWSIGNAL_H
+
+#include "Signals.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** Signal for read-mostly use: the slot list is an immutable array (snapshot).
+  connect() and disconnect() build a new snapshot and swap it in, emission iterates
+  whatever snapshot was current when it started. Emission calls the snapshot's
+  DirectSlots, it doesn't touch any reference counts and doesn't block: a per-signal
+  reader counter tells when replaced snapshots can be freed. Slots may connect and
+  disconnect (even themselves) while being notified, and emission may run in several
+  threads at once. Replaced snapshots are freed by the writer that replaces them or
+  by the emission that ends the last read, if no emission is in progress. Emissions
+  that overlap without pause keep them alive until the overlap ends **/
+template<typename... args>
+class CowSignal
+{
+  public:
+    /** connection handle, 0 is never used **/
+    using handle = unsigned;
+
+    /** constructor **/
+    CowSignal()
+      : current_(new Snapshot()),
+      readers_(0),
+      retiredPending_(false),
+      nextId_(1)
+    {
+    }
+
+    /** destructor. Must not run concurrently with emission **/
+    ~CowSignal()
+    {
+      delete current_.load();
+      for (auto s : retired_)
+      {
+        delete s;
+      }
+    }
+
+    /** connect a non-static member function **/
+    template<typename T, typename ReturnType>
+    handle connect(T& obj, ReturnType (T::*memFn)(args...))
+    {
+      return add(new ObjDelegate<T, ReturnType, args...>(obj, memFn));
+    }
+
+    /** connect a static member function or free function **/
+    template<typename ReturnType>
+    handle connect(ReturnType (*fn)(args...))
+    {
+      return add(new FnDelegate<ReturnType, args...>(fn));
+    }
+
+    /** disconnect. Emissions that already grabbed a snapshot still call the slot **/
+    void disconnect(handle h)
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      const Snapshot* old = current_.load();
+      Snapshot* next = new Snapshot();
+      next->slots.reserve(old->slots.size());
+      next->calls.reserve(old->slots.size());
+      for (size_t i = 0; i < old->slots.size(); i++)
+      {
+        if (old->slots[i].id != h)
+        {
+          next->slots.push_back(old->slots[i]);
+          next->calls.push_back(old->calls[i]);
+        }
+      }
+      publish(next);
+    }
+
+    /** notify all slots of the current snapshot, in connection order **/
+    void operator()(args... a) const
+    {
+      Reading reading(*this);
+      for (const DirectSlot<args...>& slot : reading.snapshot->calls)
+      {
+        slot(a...);
+      }
+    }
+
+    /** number of connected slots **/
+    size_t count() const
+    {
+      Reading reading(*this);
+      return reading.snapshot->slots.size();
+    }
+
+  private:
+    /** don't allow copy construction **/
+    CowSignal(const CowSignal& other);
+
+    /** don't allow copy assignment **/
+    CowSignal& operator= (CowSignal& other);
+
+    /** snapshot entry. Delegates are shared by all snapshots that contain them **/
+    struct Slot
+    {
+      handle id;
+      std::shared_ptr<const AbstractDelegate<args...>> delegate;
+    };
+
+    /** immutable slot array. calls[i] is the call target of slots[i],
+      emission only reads calls **/
+    struct Snapshot
+    {
+      std::vector<DirectSlot<args...>> calls;
+      std::vector<Slot> slots;
+    };
+
+    /** registers a reader for its own lifetime and grabs the current snapshot **/
+    struct Reading
+    {
+      explicit Reading(const CowSignal& signal)
+        : signal_(signal)
+      {
+        signal_.readers_.fetch_add(1);
+        snapshot = signal_.current_.load();
+      }
+
+      ~Reading()
+      {
+        if (signal_.readers_.fetch_sub(1) == 1 && signal_.retiredPending_.load())
+        {
+          signal_.reclaim();
+        }
+      }
+
+      const CowSignal& signal_;
+      const Snapshot* snapshot;
+    };
+
+    handle add(const AbstractDelegate<args...>* delegate)
+    {
+      std::shared_ptr<const AbstractDelegate<args...>> d(delegate);
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      const Snapshot* old = current_.load();
+      Snapshot* next = new Snapshot();
+      next->slots.reserve(old->slots.size() + 1);
+      next->calls.reserve(old->slots.size() + 1);
+      next->slots = old->slots;
+      next->calls = old->calls;
+      handle id = nextId_++;
+      next->slots.push_back(Slot{id, d});
+      next->calls.push_back(delegate->slot());
+      publish(next);
+      return id;
+    }
+
+    /** swap in a new snapshot and free the replaced ones if nobody is reading.
+      Called with writeMutex_ held **/
+    void publish(Snapshot* next)
+    {
+      retired_.push_back(current_.exchange(next));
+      // a reader that starts after this point sees next. If one is still reading,
+      // the flag makes the last of them free the replaced snapshots
+      retiredPending_.store(true);
+      freeRetired();
+    }
+
+    /** free the replaced snapshots after the last reader is done. Emission must not
+      block on a writer: if the lock is taken, the writer or a later reader frees them **/
+    void reclaim() const
+    {
+      std::unique_lock<std::mutex> lock(writeMutex_, std::try_to_lock);
+      if (lock)
+      {
+        freeRetired();
+      }
+    }
+
+    /** called with writeMutex_ held **/
+    void freeRetired() const
+    {
+      if (readers_.load() != 0)
+      {
+        return;
+      }
+      for (auto s : retired_)
+      {
+        delete s;
+      }
+      retired_.clear();
+      retiredPending_.store(false);
+    }
+
+    std::atomic<const Snapshot*> current_;
+    mutable std::atomic<unsigned> readers_;
+    mutable std::mutex writeMutex_;
+    /** replaced snapshots, guarded by writeMutex_ **/
+    mutable std::vector<const Snapshot*> retired_;
+    mutable std::atomic<bool> retiredPending_;
+    handle nextId_;
+};
+
+#endif // COWSIGNAL_H
@@ -0,0 +1,119 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "Signals.h"
+
+#include <tuple>
+#include <type_traits>
+
+/** position of T in a list of types, resolved at compile time.
+  Fails to compile if T isn't in the list **/
+template<typename T, typename... Ts>
+struct TypeIndex;
+
+template<typename T, typename... rest>
+struct TypeIndex<T, T, rest...>
+{
+  static const unsigned value = 0;
+};
+
+template<typename T, typename U, typename... rest>
+struct TypeIndex<T, U, rest...>
+{
+  static const unsigned value = 1 + TypeIndex<T, rest...>::value;
+};
+
+template<typename T>
+struct TypeIndex<T>
+{
+  static_assert(sizeof(T) == 0, "event type is not handled by this dispatcher");
+  static const unsigned value = 0;
+};
+
+/** true if T occurs in a list of types **/
+template<typename T, typename... Ts>
+struct ContainsType
+{
+  static const bool value = false;
+};
+
+template<typename T, typename U, typename... rest>
+struct ContainsType<T, U, rest...>
+{
+  static const bool value = std::is_same<T, U>::value || ContainsType<T, rest...>::value;
+};
+
+/** true if a type occurs more than once in a list of types **/
+template<typename... Ts>
+struct HasDuplicates
+{
+  static const bool value = false;
+};
+
+template<typename T, typename... rest>
+struct HasDuplicates<T, rest...>
+{
+  static const bool value = ContainsType<T, rest...>::value || HasDuplicates<rest...>::value;
+};
+
+/** Dispatcher for a fixed set of event types, one Signal<const Ev&> per type.
+  emit(ev) picks the signal from the static type of ev through TypeIndex, so there is
+  no runtime lookup and nothing depends on RTTI or dynamic_cast. Events are matched
+  by exact type: a derived event must be emitted as its base type explicitly **/
+template<typename... Events>
+class Dispatcher
+{
+  public:
+    static_assert(!HasDuplicates<Events...>::value, "event types of a dispatcher must be distinct");
+
+    /** constructor **/
+    Dispatcher()
+    {
+    }
+
+    /** signal of an event type, for connections and blocking **/
+    template<typename Ev>
+    Signal<const Ev&>& signal()
+    {
+      return std::get<TypeIndex<Ev, Events...>::value>(signals_);
+    }
+
+    /** signal of an event type **/
+    template<typename Ev>
+    const Signal<const Ev&>& signal() const
+    {
+      return std::get<TypeIndex<Ev, Events...>::value>(signals_);
+    }
+
+    /** notify all connections of the event's type **/
+    template<typename Ev>
+    void emit(const Ev& ev) const
+    {
+      std::get<TypeIndex<Ev, Events...>::value>(signals_)(ev);
+    }
+
+    /** connect a non-static member function to the signal of its event type **/
+    template<typename Ev, typename T, typename ReturnType>
+    Connection<const Ev&>* connect(T& obj, ReturnType (T::*memFn)(const Ev&))
+    {
+      return ::connect(signal<Ev>(), obj, memFn);
+    }
+
+    /** connect a static member function or free function to the signal of its event type **/
+    template<typename Ev, typename ReturnType>
+    Connection<const Ev&>* connect(ReturnType (*fn)(const Ev&))
+    {
+      return ::connect(signal<Ev>(), fn);
+    }
+
+  private:
+    /** don't allow copy construction **/
+    Dispatcher(const Dispatcher& other);
+
+    /** don't allow copy assignment **/
+    Dispatcher& operator= (Dispatcher& other);
+
+    std::tuple<Signal<const Events&>...> signals_;
+};
+
+#endif // DISPATCHER_H
@@ -0,0 +1,1248 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include "Signals.h"
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/** Linux event loop that delivers queued signal emissions, delayed emissions
+  and file descriptor readiness in one thread.
+  Cross-thread wakeups use an eventfd, delayed emissions a single timerfd that
+  is always armed to the earliest deadline. Readiness is waited for with epoll
+  or io_uring, see EpollPoller and UringPoller. **/
+
+/** Interface for queues that are drained by an EventLoop **/
+class AbstractQueue
+{
+  public:
+    /** deliver everything that is pending. Called from the loop thread **/
+    virtual void drain() = 0;
+    virtual ~AbstractQueue() {}
+};
+
+/** readiness event reported by a poller backend **/
+struct PollEvent
+{
+  int fd;
+  uint32_t events;
+};
+
+/** Interface for the readiness backends of an EventLoop.
+  Event masks use the EPOLLIN/EPOLLOUT/... values, which match poll(2).
+  Watches are level-triggered **/
+class AbstractPoller
+{
+  public:
+    /** start watching fd. For counter fds (eventfd, timerfd) the backend
+      consumes the 8 byte counter itself before reporting the fd as readable.
+      Counter fds stay registered for the lifetime of the poller **/
+    virtual void add(int fd, uint32_t events, bool counter) = 0;
+    /** change the event mask of a watched fd **/
+    virtual void modify(int fd, uint32_t events) = 0;
+    /** stop watching fd **/
+    virtual void remove(int fd) = 0;
+    /** wait for at most max events. timeoutMs < 0 waits indefinitely.
+      Returns the number of events, 0 on timeout or interruption **/
+    virtual int wait(PollEvent* events, int max, int timeoutMs) = 0;
+    virtual ~AbstractPoller() {}
+};
+
+/** epoll backend **/
+class EpollPoller : public AbstractPoller
+{
+  public:
+    /** constructor. Throws std::system_error if epoll is not available **/
+    EpollPoller()
+      : fd_(::epoll_create1(EPOLL_CLOEXEC))
+    {
+      if (fd_ < 0)
+      {
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+      }
+    }
+
+    ~EpollPoller()
+    {
+      ::close(fd_);
+    }
+
+    void add(int fd, uint32_t events, bool counter) override
+    {
+      if (counter)
+      {
+        counters_.push_back(fd);
+      }
+      control(EPOLL_CTL_ADD, fd, events);
+    }
+
+    void modify(int fd, uint32_t events) override
+    {
+      control(EPOLL_CTL_MOD, fd, events);
+    }
+
+    void remove(int fd) override
+    {
+      ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    int wait(PollEvent* events, int max, int timeoutMs) override
+    {
+      epoll_event ev[maxEvents];
+      int n = ::epoll_wait(fd_, ev, std::min(max, int(maxEvents)), timeoutMs);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          return 0;
+        }
+        throw std::system_error(errno, std::system_category(), "epoll_wait");
+      }
+      for (int i = 0; i < n; i++)
+      {
+        events[i].fd = ev[i].data.fd;
+        events[i].events = ev[i].events;
+        if (std::find(counters_.begin(), counters_.end(), ev[i].data.fd) != counters_.end())
+        {
+          uint64_t count;
+          while (::read(ev[i].data.fd, &count, sizeof(count)) < 0 && errno == EINTR)
+          {
+          }
+        }
+      }
+      return n;
+    }
+
+  private:
+    /** don't allow copy construction **/
+    EpollPoller(const EpollPoller& other);
+
+    /** don't allow copy assignment **/
+    EpollPoller& operator= (EpollPoller& other);
+
+    static const int maxEvents = 64;
+
+    void control(int op, int fd, uint32_t events)
+    {
+      epoll_event ev = {};
+      ev.events = events;
+      ev.data.fd = fd;
+      if (::epoll_ctl(fd_, op, fd, &ev) < 0)
+      {
+        throw std::system_error(errno, std::system_category(), "epoll_ctl");
+      }
+    }
+
+    int fd_;
+    std::vector<int> counters_;
+};
+
+/** io_uring backend, talking to the kernel through the raw syscalls.
+  Readiness is watched with POLL_ADD, counter fds are read with READ requests so the
+  wakeup read is folded into the ring. Re-arms are queued and submitted together with
+  the next wait in a single io_uring_enter, completions are reaped in batches.
+  Needs POLL_ADD, POLL_REMOVE, READ and TIMEOUT (Linux 5.6). The constructor throws
+  std::system_error if the kernel (or a seccomp filter) doesn't provide them **/
+class UringPoller : public AbstractPoller
+{
+  public:
+    /** constructor **/
+    explicit UringPoller(unsigned entries = 256)
+      : fd_(-1),
+      sqRing_(nullptr),
+      cqRing_(nullptr),
+      sqes_(nullptr),
+      sqRingSize_(0),
+      cqRingSize_(0),
+      sqesSize_(0),
+      timeout_{0, 0},
+      generation_(0)
+    {
+      io_uring_params params = {};
+      fd_ = int(::syscall(__NR_io_uring_setup, entries, &params));
+      if (fd_ < 0)
+      {
+        throw std::system_error(errno, std::system_category(), "io_uring_setup");
+      }
+      sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+      if (single)
+      {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+      }
+      sqRing_ = map(sqRingSize_, IORING_OFF_SQ_RING);
+      cqRing_ = single ? sqRing_ : map(cqRingSize_, IORING_OFF_CQ_RING);
+      sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe*>(map(sqesSize_, IORING_OFF_SQES));
+      if (!sqRing_ || !cqRing_ || !sqes_)
+      {
+        int err = errno;
+        release();
+        throw std::system_error(err, std::system_category(), "io_uring mmap");
+      }
+
+      char* sq = static_cast<char*>(sqRing_);
+      sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sqEntries_ = params.sq_entries;
+      sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      char* cq = static_cast<char*>(cqRing_);
+      cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+      sqLocalTail_ = *sqTail_;
+
+      if (!supported())
+      {
+        release();
+        throw std::system_error(ENOSYS, std::system_category(), "io_uring opcodes");
+      }
+    }
+
+    ~UringPoller()
+    {
+      release();
+    }
+
+    void add(int fd, uint32_t events, bool counter) override
+    {
+      Watch& w = watches_[fd];
+      w.events = events;
+      w.counter = counter;
+      w.generation = ++generation_;
+      arm(fd, w);
+    }
+
+    void modify(int fd, uint32_t events) override
+    {
+      auto it = watches_.find(fd);
+      if (it == watches_.end())
+      {
+        return;
+      }
+      cancelPoll(fd, it->second);
+      it->second.events = events;
+      it->second.generation = ++generation_;
+      arm(fd, it->second);
+    }
+
+    void remove(int fd) override
+    {
+      auto it = watches_.find(fd);
+      if (it == watches_.end() || it->second.counter)
+      {
+        return; // a READ may still target the counter's buffer
+      }
+      cancelPoll(fd, it->second);
+      watches_.erase(it);
+    }
+
+    int wait(PollEvent* events, int max, int timeoutMs) override
+    {
+      unsigned waitFor = 0;
+      if (timeoutMs != 0 && !completionsPending())
+      {
+        waitFor = 1;
+        if (timeoutMs > 0)
+        {
+          timeout_.tv_sec = timeoutMs / 1000;
+          timeout_.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+          io_uring_sqe* sqe = next();
+          sqe->opcode = IORING_OP_TIMEOUT;
+          sqe->fd = -1;
+          sqe->addr = reinterpret_cast<uintptr_t>(&timeout_);
+          sqe->len = 1;
+          sqe->off = 1; // also completes as soon as anything else completes
+          sqe->user_data = timeoutTag;
+        }
+      }
+      enter(waitFor);
+      return reap(events, max);
+    }
+
+  private:
+    /** don't allow copy construction **/
+    UringPoller(const UringPoller& other);
+
+    /** don't allow copy assignment **/
+    UringPoller& operator= (UringPoller& other);
+
+    /** watched fd. generation tags user_data so that completions of cancelled
+      requests can be told apart from the current one. It comes from a poller-wide
+      counter, so a watch that is removed and added again doesn't reuse a tag **/
+    struct Watch
+    {
+      Watch() : events(0), counter(false), generation(0), value(0) {}
+      uint32_t events;
+      bool counter;
+      uint32_t generation;
+      uint64_t value;
+    };
+
+    static const uint64_t timeoutTag = ~uint64_t(0);
+    static const uint64_t ignoreTag = ~uint64_t(0) - 1;
+
+    static uint64_t tag(int fd, const Watch& w)
+    {
+      return (uint64_t(w.generation) << 32) | uint32_t(fd);
+    }
+
+    void* map(size_t size, off_t offset)
+    {
+      void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+      return (p == MAP_FAILED) ? nullptr : p;
+    }
+
+    void release()
+    {
+      if (sqes_) ::munmap(sqes_, sqesSize_);
+      if (cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+      if (sqRing_) ::munmap(sqRing_, sqRingSize_);
+      if (fd_ >= 0) ::close(fd_);
+      sqes_ = nullptr;
+      cqRing_ = sqRing_ = nullptr;
+      fd_ = -1;
+    }
+
+    /** check that the kernel knows all the opcodes used here **/
+    bool supported()
+    {
+      const unsigned ops = IORING_OP_LAST;
+      std::vector<char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+      io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+      if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, ops) < 0)
+      {
+        return false;
+      }
+      const unsigned needed[] = {IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_READ, IORING_OP_TIMEOUT};
+      for (unsigned op : needed)
+      {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /** get a cleared submission entry, flushing the queue first if it is full **/
+    io_uring_sqe* next()
+    {
+      if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+      {
+        enter(0);
+      }
+      unsigned index = sqLocalTail_ & sqMask_;
+      io_uring_sqe* sqe = &sqes_[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      sqArray_[index] = index;
+      sqLocalTail_++;
+      return sqe;
+    }
+
+    /** queue the request that reports the next readiness of fd **/
+    void arm(int fd, Watch& w)
+    {
+      io_uring_sqe* sqe = next();
+      sqe->fd = fd;
+      sqe->user_data = tag(fd, w);
+      if (w.counter)
+      {
+        sqe->opcode = IORING_OP_READ;
+        sqe->addr = reinterpret_cast<uintptr_t>(&w.value);
+        sqe->len = sizeof(w.value);
+      }
+      else
+      {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = w.events & ~uint32_t(EPOLLET | EPOLLONESHOT);
+      }
+    }
+
+    void cancelPoll(int fd, const Watch& w)
+    {
+      io_uring_sqe* sqe = next();
+      sqe->opcode = IORING_OP_POLL_REMOVE;
+      sqe->fd = -1;
+      sqe->addr = tag(fd, w);
+      sqe->user_data = ignoreTag;
+    }
+
+    bool completionsPending() const
+    {
+      return __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    }
+
+    /** submit everything queued and optionally wait for completions **/
+    void enter(unsigned waitFor)
+    {
+      unsigned submit = sqLocalTail_ - *sqTail_;
+      __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+      if (submit == 0 && waitFor == 0)
+      {
+        return;
+      }
+      unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+      if (::syscall(__NR_io_uring_enter, fd_, submit, waitFor, flags, nullptr, 0) < 0
+        && errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY)
+      {
+        throw std::system_error(errno, std::system_category(), "io_uring_enter");
+      }
+    }
+
+    /** turn completions into events and queue the re-arms **/
+    int reap(PollEvent* events, int max)
+    {
+      int n = 0;
+      unsigned head = *cqHead_;
+      unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+      for (; head != tail && n < max; head++)
+      {
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == timeoutTag || cqe.user_data == ignoreTag)
+        {
+          continue;
+        }
+        int fd = int(uint32_t(cqe.user_data));
+        auto it = watches_.find(fd);
+        if (it == watches_.end() || tag(fd, it->second) != cqe.user_data)
+        {
+          continue; // stale completion of a removed or modified watch
+        }
+        if (cqe.res >= 0)
+        {
+          events[n].fd = fd;
+          events[n].events = it->second.counter ? uint32_t(EPOLLIN) : uint32_t(cqe.res);
+          n++;
+        }
+        else if (cqe.res == -ECANCELED)
+        {
+          continue; // whoever cancelled it has queued the request it wants
+        }
+        else if (cqe.res != -EINTR && cqe.res != -EAGAIN)
+        {
+          events[n].fd = fd;
+          events[n].events = EPOLLERR;
+          n++;
+        }
+        arm(fd, it->second);
+      }
+      __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+      return n;
+    }
+
+    int fd_;
+    void* sqRing_;
+    void* cqRing_;
+    io_uring_sqe* sqes_;
+    size_t sqRingSize_;
+    size_t cqRingSize_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned* sqArray_;
+    unsigned sqLocalTail_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe* cqes_;
+
+    __kernel_timespec timeout_;
+    std::unordered_map<int, Watch> watches_;
+    uint32_t generation_;
+};
+
+class EventLoop
+{
+  public:
+    /** clock used for delayed emissions **/
+    using Clock = std::chrono::steady_clock;
+    /** fd readiness callback, receives the epoll event mask **/
+    using FdCallback = std::function<void(uint32_t events)>;
+    /** delayed task **/
+    using Task = std::function<void()>;
+
+    /** readiness backend selection **/
+    enum class Backend
+    {
+      automatic, // io_uring if the kernel supports it, epoll otherwise
+      epoll,
+      uring
+    };
+
+    /** constructor. Throws std::system_error if the kernel objects can't be created
+      or if Backend::uring was requested explicitly and isn't available **/
+    explicit EventLoop(Backend backend = Backend::automatic)
+      : wakeFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      timerFd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      backend_(Backend::epoll),
+      timerSeq_(0),
+      pending_(false),
+      parked_(false),
+      wakeSent_(false),
+      stopped_(false),
+      spinLimit_(0),
+      spinBudget_(0),
+      interArrival_(0)
+    {
+      if (wakeFd_ < 0 || timerFd_ < 0)
+      {
+        int err = errno;
+        closeAll();
+        throw std::system_error(err, std::system_category(), "EventLoop");
+      }
+      try
+      {
+        if (backend != Backend::epoll)
+        {
+          try
+          {
+            poller_.reset(new UringPoller());
+            backend_ = Backend::uring;
+          }
+          catch (const std::system_error&)
+          {
+            if (backend == Backend::uring)
+            {
+              throw;
+            }
+          }
+        }
+        if (!poller_)
+        {
+          poller_.reset(new EpollPoller());
+        }
+        poller_->add(wakeFd_, EPOLLIN, true);
+        poller_->add(timerFd_, EPOLLIN, true);
+      }
+      catch (...)
+      {
+        poller_.reset();
+        closeAll();
+        throw;
+      }
+    }
+
+    /** backend that is actually in use **/
+    Backend backend() const
+    {
+      return backend_;
+    }
+
+    /** destructor. Closes the loop's own descriptors, watched fds are left alone **/
+    ~EventLoop()
+    {
+      poller_.reset();
+      closeAll();
+    }
+
+    /** watch fd for the given epoll events (level-triggered). Loop thread only **/
+    void watch(int fd, uint32_t events, FdCallback callback)
+    {
+      auto it = watches_.find(fd);
+      if (it != watches_.end())
+      {
+        it->second = std::move(callback);
+        poller_->modify(fd, events);
+        return;
+      }
+      poller_->add(fd, events, false);
+      watches_[fd] = std::move(callback);
+    }
+
+    /** stop watching fd. Loop thread only **/
+    void unwatch(int fd)
+    {
+      if (watches_.erase(fd))
+      {
+        poller_->remove(fd);
+      }
+    }
+
+    /** mark a queue as having pending items. Thread-safe.
+      The eventfd is only written if the loop thread is parked in the poller and
+      nobody has woken it yet, so a burst of emissions costs at most one wakeup,
+      and none while the loop is busy or spinning **/
+    void schedule(AbstractQueue& queue)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(&queue);
+        pending_.store(true, std::memory_order_relaxed);
+      }
+      // pairs with the fence in runOnce(): either we see parked_ or the loop sees pending_
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (parked_.load(std::memory_order_relaxed) && !wakeSent_.exchange(true))
+      {
+        wakeup();
+      }
+    }
+
+    /** enable busy polling: before parking in the poller, the loop thread spins
+      on its ready list for up to limit. The actual spin budget adapts to the
+      recent inter-arrival time of queued emissions: twice the average if that is
+      below limit, no spinning at all otherwise. Fd readiness and timers are only
+      noticed after the spin, so they may be delayed by up to limit.
+      A zero limit (the default) disables spinning. Loop thread only **/
+    void busy_poll(std::chrono::nanoseconds limit)
+    {
+      spinLimit_ = limit;
+      spinBudget_ = limit;
+      interArrival_ = std::chrono::nanoseconds(0);
+      lastArrival_ = Clock::now();
+    }
+
+    /** current adaptive spin budget **/
+    std::chrono::nanoseconds spin_budget() const
+    {
+      return spinBudget_;
+    }
+
+    /** run task after delay in the loop thread. Thread-safe.
+      owner can later be passed to cancel() to drop all of its pending tasks **/
+    void after(Clock::duration delay, Task task, const void* owner = nullptr)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      uint64_t seq = timerSeq_++;
+      timers_.push_back(Timer{Clock::now() + delay, seq, owner, std::move(task)});
+      std::push_heap(timers_.begin(), timers_.end(), laterThan);
+      // re-arm only if the new timer became the earliest one
+      if (timers_.front().seq == seq)
+      {
+        armTimer();
+      }
+    }
+
+    /** drop a queue from the ready list, from the drain pass in progress and all
+      delayed tasks of owner. Thread-safe **/
+    void cancel(const void* owner)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.erase(std::remove(ready_.begin(), ready_.end(), owner), ready_.end());
+      std::replace_if(draining_.begin(), draining_.end(),
+        [owner](const AbstractQueue* q) {return q == owner;}, nullptr);
+      timers_.erase(std::remove_if(timers_.begin(), timers_.end(),
+        [owner](const Timer& t) {return t.owner == owner;}), timers_.end());
+      std::make_heap(timers_.begin(), timers_.end(), laterThan);
+    }
+
+    /** wait for events once and dispatch them.
+      timeoutMs < 0 waits indefinitely. Returns false if the loop was stopped **/
+    bool runOnce(int timeoutMs = -1)
+    {
+      if (timeoutMs != 0 && spin())
+      {
+        timeoutMs = 0; // work arrived while spinning, only collect fd events
+      }
+      parked_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (pending_.load(std::memory_order_relaxed))
+      {
+        timeoutMs = 0;
+      }
+      PollEvent events[maxEvents];
+      int n = poller_->wait(events, maxEvents, timeoutMs);
+      parked_.store(false, std::memory_order_relaxed);
+      wakeSent_.store(false, std::memory_order_relaxed);
+      bool fireTimers = false;
+      for (int i = 0; i < n; i++)
+      {
+        int fd = events[i].fd;
+        if (fd == wakeFd_)
+        {
+          // nothing to do, pending_ is checked below
+        }
+        else if (fd == timerFd_)
+        {
+          fireTimers = true;
+        }
+        else
+        {
+          auto it = watches_.find(fd);
+          if (it != watches_.end())
+          {
+            // copy, the callback may unwatch itself
+            FdCallback cb = it->second;
+            cb(events[i].events);
+          }
+        }
+      }
+      if (pending_.load(std::memory_order_acquire))
+      {
+        drain();
+      }
+      if (fireTimers)
+      {
+        runTimers();
+      }
+      return !stopped_;
+    }
+
+    /** run until stop() is called **/
+    void run()
+    {
+      stopped_ = false;
+      while (runOnce())
+      {
+      }
+    }
+
+    /** make run() return after the current iteration. Thread-safe **/
+    void stop()
+    {
+      stopped_ = true;
+      wakeup();
+    }
+
+  private:
+    /** don't allow copy construction **/
+    EventLoop(const EventLoop& other);
+
+    /** don't allow copy assignment **/
+    EventLoop& operator= (EventLoop& other);
+
+    /** pending delayed task **/
+    struct Timer
+    {
+      Clock::time_point deadline;
+      uint64_t seq;
+      const void* owner;
+      Task task;
+    };
+
+    /** heap order: earliest deadline on top, FIFO for equal deadlines **/
+    static bool laterThan(const Timer& a, const Timer& b)
+    {
+      return (a.deadline != b.deadline) ? (a.deadline > b.deadline) : (a.seq > b.seq);
+    }
+
+    static const int maxEvents = 64;
+
+    /** spin on the ready list for the current budget.
+      Returns true as soon as something is pending **/
+    bool spin()
+    {
+      if (spinBudget_.count() == 0)
+      {
+        return pending_.load(std::memory_order_relaxed);
+      }
+      Clock::time_point deadline = Clock::now() + spinBudget_;
+      for (;;)
+      {
+        // check the clock only every few iterations, it is more expensive than pause
+        for (int i = 0; i < 64; i++)
+        {
+          if (pending_.load(std::memory_order_relaxed))
+          {
+            return true;
+          }
+          cpuRelax();
+        }
+        if (Clock::now() >= deadline)
+        {
+          return false;
+        }
+      }
+    }
+
+    /** spin-wait hint for the CPU **/
+    static void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      asm volatile("yield");
+#endif
+    }
+
+    /** update the spin budget from the time since the previous drain.
+      Exponential moving average with weight 1/8 **/
+    void adapt(Clock::time_point now)
+    {
+      if (spinLimit_.count() == 0)
+      {
+        return;
+      }
+      std::chrono::nanoseconds sample = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastArrival_);
+      lastArrival_ = now;
+      interArrival_ += (sample - interArrival_) / 8;
+      if (interArrival_ < spinLimit_)
+      {
+        spinBudget_ = std::min(spinLimit_, 2 * interArrival_);
+      }
+      else
+      {
+        spinBudget_ = std::chrono::nanoseconds(0);
+      }
+    }
+
+    void wakeup()
+    {
+      uint64_t one = 1;
+      while (::write(wakeFd_, &one, sizeof(one)) < 0 && errno == EINTR)
+      {
+      }
+    }
+
+    /** drain all queues that were scheduled up to now, in scheduling order **/
+    void drain()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        draining_.swap(ready_);
+        pending_.store(false, std::memory_order_relaxed);
+      }
+      adapt(Clock::now());
+      // a slot may destroy a queue that is still to be drained, cancel() nulls its entry
+      Draining pass(*this);
+      for (;;)
+      {
+        AbstractQueue* q;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (pass.next_ == draining_.size())
+          {
+            draining_.clear();
+            pass.done_ = true;
+            break;
+          }
+          q = draining_[pass.next_++];
+        }
+        if (q != nullptr)
+        {
+          q->drain();
+        }
+      }
+    }
+
+    /** a drain() pass. If a slot throws, the queues that weren't drained yet
+      go back to the front of the ready list **/
+    struct Draining
+    {
+      explicit Draining(EventLoop& loop)
+        : loop_(loop),
+        next_(0),
+        done_(false)
+      {
+      }
+
+      ~Draining()
+      {
+        if (!done_)
+        {
+          loop_.requeue(next_);
+        }
+      }
+
+      EventLoop& loop_;
+      size_t next_;
+      bool done_;
+    };
+
+    /** put draining_ from index first on back in front of ready_ **/
+    void requeue(size_t first)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::vector<AbstractQueue*> rest;
+      for (size_t i = first; i < draining_.size(); i++)
+      {
+        if (draining_[i] != nullptr)
+        {
+          rest.push_back(draining_[i]);
+        }
+      }
+      draining_.clear();
+      ready_.insert(ready_.begin(), rest.begin(), rest.end());
+      if (!ready_.empty())
+      {
+        pending_.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    /** run all expired timers and re-arm the timerfd for the next one **/
+    void runTimers()
+    {
+      Clock::time_point now = Clock::now();
+      for (;;)
+      {
+        Task task;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (timers_.empty() || timers_.front().deadline > now)
+          {
+            break;
+          }
+          std::pop_heap(timers_.begin(), timers_.end(), laterThan);
+          task = std::move(timers_.back().task);
+          timers_.pop_back();
+        }
+        task();
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      armTimer();
+    }
+
+    /** arm the timerfd for the earliest deadline, or disarm it.
+      Called with mutex_ held so that concurrent re-arms can't reorder **/
+    void armTimer()
+    {
+      itimerspec spec = {};
+      if (!timers_.empty())
+      {
+        auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          timers_.front().deadline - Clock::now()).count();
+        if (delay < 1)
+        {
+          delay = 1; // zero would disarm
+        }
+        spec.it_value.tv_sec = delay / 1000000000;
+        spec.it_value.tv_nsec = delay % 1000000000;
+      }
+      ::timerfd_settime(timerFd_, 0, &spec, nullptr);
+    }
+
+    void closeAll()
+    {
+      if (wakeFd_ >= 0) ::close(wakeFd_);
+      if (timerFd_ >= 0) ::close(timerFd_);
+    }
+
+    int wakeFd_;
+    int timerFd_;
+    std::unique_ptr<AbstractPoller> poller_;
+    Backend backend_;
+
+    std::mutex mutex_;
+    std::vector<AbstractQueue*> ready_;
+    std::vector<AbstractQueue*> draining_;
+    std::vector<Timer> timers_;
+    uint64_t timerSeq_;
+    /** ready_ is not empty **/
+    std::atomic<bool> pending_;
+    /** loop thread is (about to be) blocked in the poller **/
+    std::atomic<bool> parked_;
+    /** eventfd was written since the loop thread parked **/
+    std::atomic<bool> wakeSent_;
+    std::atomic<bool> stopped_;
+
+    std::chrono::nanoseconds spinLimit_;
+    std::chrono::nanoseconds spinBudget_;
+    std::chrono::nanoseconds interArrival_;
+    Clock::time_point lastArrival_;
+
+    std::unordered_map<int, FdCallback> watches_;
+};
+
+/** what a bounded QueuedSignal does with an emission while it is full **/
+enum class Overflow
+{
+  block,       // wait until the loop has drained the queue
+  drop_newest, // discard the new emission
+  drop_oldest, // discard the oldest pending emission
+  coalesce     // replace the pending emission with the same key, drop_newest if there is none
+};
+
+/** outcome of QueuedSignal::try_emit() **/
+enum class EmitResult
+{
+  queued,    // appended to the queue
+  displaced, // appended, the oldest pending emission was dropped
+  coalesced, // replaced a pending emission with the same key
+  dropped,   // discarded
+  full       // not queued, the queue is full and the policy is block
+};
+
+/** Signal proxy that queues emissions from any thread and delivers them to a target
+  Signal in the loop thread. Emissions are drained in batches: one wakeup delivers
+  everything that was queued since the previous drain.
+  The queue is unbounded by default. With a capacity, at most that many emissions
+  are pending at any time (plus the batch that is being delivered) and the
+  Overflow policy decides what happens to the rest. Delayed emissions are
+  not counted **/
+template<typename... args>
+class QueuedSignal : public AbstractQueue
+{
+  public:
+    /** stored argument tuple **/
+    using tuple_type = std::tuple<typename std::decay<args>::type...>;
+    /** coalescing key of an emission, equal keys replace each other **/
+    using key_fn = std::function<size_t(const tuple_type&)>;
+
+    /** constructor. Unbounded queue **/
+    QueuedSignal(EventLoop& loop, Signal<args...>& target)
+      : loop_(loop),
+      target_(target),
+      scheduled_(false),
+      capacity_(0),
+      policy_(Overflow::block),
+      dropped_(0),
+      coalesced_(0)
+    {
+    }
+
+    /** constructor. Bounded queue, capacity must not be 0.
+      Use the key_fn constructor for Overflow::coalesce **/
+    QueuedSignal(EventLoop& loop, Signal<args...>& target, size_t capacity, Overflow policy = Overflow::block)
+      : loop_(loop),
+      target_(target),
+      scheduled_(false),
+      capacity_(capacity),
+      policy_(policy),
+      dropped_(0),
+      coalesced_(0)
+    {
+    }
+
+    /** constructor. Bounded queue that coalesces emissions with equal keys **/
+    QueuedSignal(EventLoop& loop, Signal<args...>& target, size_t capacity, key_fn key)
+      : loop_(loop),
+      target_(target),
+      scheduled_(false),
+      capacity_(capacity),
+      policy_(Overflow::coalesce),
+      key_(std::move(key)),
+      dropped_(0),
+      coalesced_(0)
+    {
+    }
+
+    /** queue an emission. Thread-safe. With Overflow::block this waits for room,
+      so it must not be called from the loop thread while the queue is full **/
+    void operator()(args... a)
+    {
+      push(true, std::forward<args>(a)...);
+    }
+
+    /** queue an emission without ever waiting. Thread-safe **/
+    EmitResult try_emit(args... a)
+    {
+      return push(false, std::forward<args>(a)...);
+    }
+
+    /** queue an emission that is delivered after delay. Thread-safe **/
+    void emit_after(EventLoop::Clock::duration delay, args... a)
+    {
+      auto stored = std::make_shared<tuple_type>(std::forward<args>(a)...);
+      loop_.after(delay, [this, stored]()
+        {
+          emit(*stored, typename MakeIndexSequence<sizeof...(args)>::type());
+        }, this);
+    }
+
+    /** deliver all pending emissions in the loop thread **/
+    void drain() override
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        draining_.swap(pending_);
+        keys_.clear();
+        scheduled_ = false;
+      }
+      if (capacity_ != 0 && policy_ == Overflow::block)
+      {
+        space_.notify_all();
+      }
+      Delivering batch(*this);
+      while (batch.next_ < draining_.size())
+      {
+        emit(draining_[batch.next_++], typename MakeIndexSequence<sizeof...(args)>::type());
+      }
+    }
+
+    /** number of emissions discarded by the overflow policy **/
+    uint64_t dropped() const
+    {
+      return dropped_.load(std::memory_order_relaxed);
+    }
+
+    /** number of emissions that replaced a pending one **/
+    uint64_t coalesced() const
+    {
+      return coalesced_.load(std::memory_order_relaxed);
+    }
+
+    /** destructor. Drops everything that hasn't been delivered yet **/
+    ~QueuedSignal()
+    {
+      loop_.cancel(this);
+    }
+
+  private:
+    /** don't allow copy construction **/
+    QueuedSignal(const QueuedSignal& other);
+
+    /** don't allow copy assignment **/
+    QueuedSignal& operator= (QueuedSignal& other);
+
+    /** a drain() batch. Clears draining_ when done. If a slot throws, the emissions
+      after the one that threw go back to the front of pending_ and the queue is
+      scheduled again **/
+    struct Delivering
+    {
+      explicit Delivering(QueuedSignal& queue)
+        : queue_(queue),
+        next_(0)
+      {
+      }
+
+      ~Delivering()
+      {
+        if (next_ < queue_.draining_.size())
+        {
+          queue_.requeue(next_);
+        }
+        queue_.draining_.clear();
+      }
+
+      QueuedSignal& queue_;
+      size_t next_;
+    };
+
+    /** put draining_ from index first on back in front of pending_ **/
+    void requeue(size_t first)
+    {
+      bool schedule;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = draining_.size() - first;
+        pending_.insert(pending_.begin(), std::make_move_iterator(draining_.begin() + first),
+          std::make_move_iterator(draining_.end()));
+        for (auto& k : keys_)
+        {
+          k.second += count;
+        }
+        schedule = !scheduled_;
+        scheduled_ = true;
+      }
+      if (schedule)
+      {
+        loop_.schedule(*this);
+      }
+    }
+
+    EmitResult push(bool wait, args... a)
+    {
+      EmitResult result = EmitResult::queued;
+      bool schedule;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (capacity_ == 0)
+        {
+          pending_.emplace_back(std::forward<args>(a)...);
+        }
+        else
+        {
+          result = pushBounded(lock, wait, tuple_type(std::forward<args>(a)...));
+          if (result == EmitResult::dropped || result == EmitResult::full)
+          {
+            return result;
+          }
+        }
+        schedule = !scheduled_;
+        scheduled_ = true;
+      }
+      if (schedule)
+      {
+        loop_.schedule(*this);
+      }
+      return result;
+    }
+
+    /** apply the overflow policy. Called with mutex_ held **/
+    EmitResult pushBounded(std::unique_lock<std::mutex>& lock, bool wait, tuple_type&& t)
+    {
+      if (policy_ == Overflow::coalesce)
+      {
+        size_t key = key_(t);
+        auto it = keys_.find(key);
+        if (it != keys_.end())
+        {
+          pending_[it->second] = std::move(t);
+          coalesced_.fetch_add(1, std::memory_order_relaxed);
+          return EmitResult::coalesced;
+        }
+        if (pending_.size() < capacity_)
+        {
+          keys_[key] = pending_.size();
+        }
+      }
+      EmitResult result = EmitResult::queued;
+      if (pending_.size() >= capacity_)
+      {
+        switch (policy_)
+        {
+          case Overflow::block:
+            if (!wait)
+            {
+              return EmitResult::full;
+            }
+            space_.wait(lock, [this] {return pending_.size() < capacity_;});
+            break;
+          case Overflow::drop_oldest:
+            pending_.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            result = EmitResult::displaced;
+            break;
+          default:
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return EmitResult::dropped;
+        }
+      }
+      pending_.push_back(std::move(t));
+      return result;
+    }
+
+    template<unsigned... I>
+    void emit(tuple_type& t, IndexSequence<I...>)
+    {
+      target_(std::forward<args>(std::get<I>(t))...);
+    }
+
+    EventLoop& loop_;
+    Signal<args...>& target_;
+
+    std::mutex mutex_;
+    std::condition_variable space_;
+    std::deque<tuple_type> pending_;
+    std::deque<tuple_type> draining_;
+    bool scheduled_;
+
+    size_t capacity_;
+    Overflow policy_;
+    key_fn key_;
+    /** coalescing key -> position in pending_ **/
+    std::unordered_map<size_t, size_t> keys_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> coalesced_;
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,125 @@
+#ifndef PROPERTY_H
+#define PROPERTY_H
+
+#include "Signals.h"
+
+#include <functional>
+
+/** Value holder that emits its changed() signal only when the value actually changes.
+  Equal decides whether two values are the same. Changes can be grouped in a
+  transaction, which emits at most once when it is committed **/
+template<typename T, typename Equal = std::equal_to<T>>
+class Property
+{
+  public:
+    /** constructor **/
+    explicit Property(const T& value = T(), Equal equal = Equal())
+      : value_(value),
+      committed_(value),
+      equal_(equal),
+      depth_(0)
+    {
+    }
+
+    /** get the current value **/
+    const T& get() const
+    {
+      return value_;
+    }
+
+    /** set a new value. Outside of a transaction, changed() is emitted if the new
+      value differs from the old one. Inside a transaction, emission is deferred to commit() **/
+    void set(const T& value)
+    {
+      if (depth_ != 0)
+      {
+        value_ = value;
+        return;
+      }
+      if (equal_(value_, value))
+      {
+        return;
+      }
+      value_ = value;
+      committed_ = value_;
+      changed_(value_);
+    }
+
+    /** signal emitted with the new value after it changed **/
+    Signal<const T&>& changed()
+    {
+      return changed_;
+    }
+
+    /** start a transaction. Transactions nest, only the outermost commit() emits **/
+    void begin()
+    {
+      depth_++;
+    }
+
+    /** end a transaction. Emits changed() once if the value differs from the one
+      before the outermost begin(), no matter how often it was set in between **/
+    void commit()
+    {
+      if (depth_ == 0 || --depth_ != 0)
+      {
+        return;
+      }
+      if (equal_(committed_, value_))
+      {
+        return;
+      }
+      committed_ = value_;
+      changed_(value_);
+    }
+
+    /** is a transaction open? **/
+    bool in_transaction() const
+    {
+      return (depth_ != 0);
+    }
+
+  private:
+    /** don't allow copy construction **/
+    Property(const Property& other);
+
+    /** don't allow copy assignment **/
+    Property& operator= (Property& other);
+
+    T value_;
+    /** last value that was emitted (or the initial one) **/
+    T committed_;
+    Equal equal_;
+    unsigned depth_;
+    Signal<const T&> changed_;
+};
+
+/** RAII guard that runs a property transaction for its own lifetime **/
+template<typename T, typename Equal = std::equal_to<T>>
+class PropertyTransaction
+{
+  public:
+    /** constructor. begins the transaction **/
+    explicit PropertyTransaction(Property<T, Equal>& property)
+      : property_(property)
+    {
+      property_.begin();
+    }
+
+    /** destructor. commits the transaction **/
+    ~PropertyTransaction()
+    {
+      property_.commit();
+    }
+
+  private:
+    /** don't allow copy construction **/
+    PropertyTransaction(const PropertyTransaction& other);
+
+    /** don't allow copy assignment **/
+    PropertyTransaction& operator= (PropertyTransaction& other);
+
+    Property<T, Equal>& property_;
+};
+
+#endif // PROPERTY_H
@@ -0,0 +1,598 @@
+#ifndef REMOTESIGNAL_H
+#define REMOTESIGNAL_H
+
+#include "EventLoop.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/** Forwarding of signal emissions to another process over a Unix domain socket.
+  Every emission becomes one frame: a 32 bit payload length followed by the
+  arguments, serialized back to back by SerializeTraits. Both ends must run the
+  same build, frames use the native byte order and layout **/
+
+/** Serialization of one argument type. The primary template copies the bytes of
+  trivially copyable types. Other types need a specialization with the same three
+  functions: size() returns the number of bytes write() produces, read() returns
+  the position after the value or nullptr if [p, end) is too short or malformed **/
+template<typename T, typename Enable = void>
+struct SerializeTraits
+{
+  static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+    "specialize SerializeTraits for this argument type");
+
+  static size_t size(const T&)
+  {
+    return sizeof(T);
+  }
+
+  static char* write(char* p, const T& value)
+  {
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+  }
+
+  static const char* read(const char* p, const char* end, T& value)
+  {
+    if (size_t(end - p) < sizeof(T))
+    {
+      return nullptr;
+    }
+    std::memcpy(&value, p, sizeof(T));
+    return p + sizeof(T);
+  }
+};
+
+/** strings: length prefix and characters **/
+template<>
+struct SerializeTraits<std::string>
+{
+  static size_t size(const std::string& s)
+  {
+    return sizeof(uint32_t) + s.size();
+  }
+
+  static char* write(char* p, const std::string& s)
+  {
+    p = SerializeTraits<uint32_t>::write(p, uint32_t(s.size()));
+    std::memcpy(p, s.data(), s.size());
+    return p + s.size();
+  }
+
+  static const char* read(const char* p, const char* end, std::string& s)
+  {
+    uint32_t n;
+    p = SerializeTraits<uint32_t>::read(p, end, n);
+    if (p == nullptr || size_t(end - p) < n)
+    {
+      return nullptr;
+    }
+    s.assign(p, n);
+    return p + n;
+  }
+};
+
+/** vectors: length prefix and elements, copied as one block if they are trivially copyable **/
+template<typename T>
+struct SerializeTraits<std::vector<T>>
+{
+  static size_t size(const std::vector<T>& v)
+  {
+    return sizeof(uint32_t) + elementsSize(v, std::is_trivially_copyable<T>());
+  }
+
+  static char* write(char* p, const std::vector<T>& v)
+  {
+    p = SerializeTraits<uint32_t>::write(p, uint32_t(v.size()));
+    return writeElements(p, v, std::is_trivially_copyable<T>());
+  }
+
+  static const char* read(const char* p, const char* end, std::vector<T>& v)
+  {
+    uint32_t n;
+    p = SerializeTraits<uint32_t>::read(p, end, n);
+    if (p == nullptr)
+    {
+      return nullptr;
+    }
+    return readElements(p, end, n, v, std::is_trivially_copyable<T>());
+  }
+
+  private:
+    static size_t elementsSize(const std::vector<T>& v, std::true_type)
+    {
+      return v.size() * sizeof(T);
+    }
+
+    static size_t elementsSize(const std::vector<T>& v, std::false_type)
+    {
+      size_t n = 0;
+      for (const T& e : v)
+      {
+        n += SerializeTraits<T>::size(e);
+      }
+      return n;
+    }
+
+    static char* writeElements(char* p, const std::vector<T>& v, std::true_type)
+    {
+      if (!v.empty())
+      {
+        std::memcpy(p, v.data(), v.size() * sizeof(T));
+      }
+      return p + v.size() * sizeof(T);
+    }
+
+    static char* writeElements(char* p, const std::vector<T>& v, std::false_type)
+    {
+      for (const T& e : v)
+      {
+        p = SerializeTraits<T>::write(p, e);
+      }
+      return p;
+    }
+
+    static const char* readElements(const char* p, const char* end, uint32_t n, std::vector<T>& v, std::true_type)
+    {
+      if (size_t(end - p) / sizeof(T) < n)
+      {
+        return nullptr;
+      }
+      v.resize(n);
+      if (n != 0)
+      {
+        std::memcpy(v.data(), p, n * sizeof(T));
+      }
+      return p + n * sizeof(T);
+    }
+
+    static const char* readElements(const char* p, const char* end, uint32_t n, std::vector<T>& v, std::false_type)
+    {
+      v.clear();
+      // every element takes at least one byte, don't trust n for the reservation
+      v.reserve(std::min(size_t(n), size_t(end - p)));
+      for (uint32_t i = 0; i < n && p != nullptr; i++)
+      {
+        v.emplace_back();
+        p = SerializeTraits<T>::read(p, end, v.back());
+      }
+      return p;
+    }
+};
+
+/** serialization of a whole argument list **/
+template<typename... args>
+struct ArgsSerializer
+{
+  /** stored argument tuple **/
+  using tuple_type = std::tuple<typename std::decay<args>::type...>;
+
+  /** number of bytes write() produces **/
+  static size_t size(const typename std::decay<args>::type&... a)
+  {
+    size_t n = 0;
+    int expand[] = {0, (n += SerializeTraits<typename std::decay<args>::type>::size(a), 0)...};
+    (void)expand;
+    return n;
+  }
+
+  /** serialize the arguments to p, which must have room for size() bytes **/
+  static char* write(char* p, const typename std::decay<args>::type&... a)
+  {
+    int expand[] = {0, (p = SerializeTraits<typename std::decay<args>::type>::write(p, a), 0)...};
+    (void)expand;
+    return p;
+  }
+
+  /** deserialize [p, end) into t. Returns false if the data is malformed **/
+  static bool read(const char* p, const char* end, tuple_type& t)
+  {
+    return readAll(p, end, t, typename MakeIndexSequence<sizeof...(args)>::type()) == end;
+  }
+
+  private:
+    template<unsigned... I>
+    static const char* readAll(const char* p, const char* end, tuple_type& t, IndexSequence<I...>)
+    {
+      int expand[] = {0, (p = (p == nullptr) ? nullptr :
+        SerializeTraits<typename std::tuple_element<I, tuple_type>::type>::read(p, end, std::get<I>(t)), 0)...};
+      (void)expand;
+      return p;
+    }
+};
+
+/** connect to a listening Unix domain stream socket. Throws std::system_error **/
+inline int unixConnect(const std::string& path)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    throw std::system_error(ENAMETOOLONG, std::system_category(), "unix socket path");
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    throw std::system_error(errno, std::system_category(), "socket");
+  }
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::system_category(), "connect");
+  }
+  return fd;
+}
+
+/** create a listening Unix domain stream socket at path. Throws std::system_error **/
+inline int unixListen(const std::string& path, int backlog = 16)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    throw std::system_error(ENAMETOOLONG, std::system_category(), "unix socket path");
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    throw std::system_error(errno, std::system_category(), "socket");
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, backlog) < 0)
+  {
+    int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::system_category(), "bind/listen");
+  }
+  return fd;
+}
+
+/** Sending end: serializes emissions into a buffer and writes it to a connected
+  stream socket in batches. The buffer is written once it holds batchBytes, on
+  flush() and on destruction. With an EventLoop it is also written at the end of
+  the loop iteration in which the first frame was buffered, so a burst of
+  emissions costs a single write(). The fd may be non-blocking: frames that
+  can't be written yet stay buffered, with a loop they are retried after
+  retryDelay(), without one on the next flush. Errors of flushes that run in the loop
+  don't propagate into it, they are reported by error(). Not thread-safe: emit
+  from one thread (the loop thread if a loop is used). The fd is not closed **/
+template<typename... args>
+class RemoteSignalSender : public AbstractQueue
+{
+  public:
+    /** constructor. Flushes only on the batch size, flush() and destruction **/
+    explicit RemoteSignalSender(int fd, size_t batchBytes = 16384)
+      : fd_(fd),
+      loop_(nullptr),
+      batchBytes_(batchBytes),
+      scheduled_(false),
+      retrying_(false)
+    {
+    }
+
+    /** constructor. Additionally flushes in the loop after each burst **/
+    RemoteSignalSender(int fd, EventLoop& loop, size_t batchBytes = 16384)
+      : fd_(fd),
+      loop_(&loop),
+      batchBytes_(batchBytes),
+      scheduled_(false),
+      retrying_(false)
+    {
+    }
+
+    /** destructor. Writes what is still buffered, as far as the fd accepts it **/
+    ~RemoteSignalSender()
+    {
+      if (loop_ != nullptr)
+      {
+        loop_->cancel(this);
+      }
+      try
+      {
+        flush();
+      }
+      catch (const std::system_error&)
+      {
+      }
+    }
+
+    /** serialize an emission. Throws std::system_error if a flush fails,
+      the frames that weren't written stay buffered **/
+    void operator()(args... a)
+    {
+      size_t payload = ArgsSerializer<args...>::size(a...);
+      size_t offset = buffer_.size();
+      buffer_.resize(offset + sizeof(uint32_t) + payload);
+      char* p = SerializeTraits<uint32_t>::write(&buffer_[offset], uint32_t(payload));
+      ArgsSerializer<args...>::write(p, a...);
+      if (buffer_.size() >= batchBytes_)
+      {
+        if (!flush())
+        {
+          retryLater();
+        }
+      }
+      else if (loop_ != nullptr && !scheduled_)
+      {
+        scheduled_ = true;
+        loop_->schedule(*this);
+      }
+    }
+
+    /** same as operator(), for connecting a Signal **/
+    void send(args... a)
+    {
+      (*this)(std::forward<args>(a)...);
+    }
+
+    /** write the buffered frames. Returns false if the fd would block, what wasn't
+      written stays buffered. Throws std::system_error on other errors, also keeping
+      what wasn't written, so a frame is never cut short in the stream **/
+    bool flush()
+    {
+      size_t sent = 0;
+      while (sent < buffer_.size())
+      {
+        ssize_t n = ::send(fd_, buffer_.data() + sent, buffer_.size() - sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+          int err = errno;
+          if (err == EINTR)
+          {
+            continue;
+          }
+          buffer_.erase(buffer_.begin(), buffer_.begin() + sent);
+          if (err == EAGAIN || err == EWOULDBLOCK)
+          {
+            return false;
+          }
+          throw std::system_error(err, std::system_category(), "send");
+        }
+        sent += size_t(n);
+      }
+      buffer_.clear();
+      return true;
+    }
+
+    /** number of bytes waiting to be written **/
+    size_t buffered() const
+    {
+      return buffer_.size();
+    }
+
+    /** last error of a flush in the loop, cleared by clear_error() **/
+    std::error_code error() const
+    {
+      return error_;
+    }
+
+    /** forget the last error **/
+    void clear_error()
+    {
+      error_.clear();
+    }
+
+    /** flush at the end of a loop iteration. Never throws into the loop **/
+    void drain() override
+    {
+      scheduled_ = false;
+      try
+      {
+        if (!flush())
+        {
+          retryLater();
+        }
+      }
+      catch (const std::system_error& e)
+      {
+        error_ = e.code();
+      }
+    }
+
+  private:
+    /** don't allow copy construction **/
+    RemoteSignalSender(const RemoteSignalSender& other);
+
+    /** don't allow copy assignment **/
+    RemoteSignalSender& operator= (RemoteSignalSender& other);
+
+    /** delay before a flush that would have blocked is retried in the loop **/
+    static std::chrono::milliseconds retryDelay()
+    {
+      return std::chrono::milliseconds(1);
+    }
+
+    /** flush again after retryDelay(). The timer is owned by this, the destructor
+      cancels it **/
+    void retryLater()
+    {
+      if (loop_ == nullptr || retrying_)
+      {
+        return;
+      }
+      retrying_ = true;
+      loop_->after(retryDelay(), [this]()
+      {
+        retrying_ = false;
+        drain();
+      }, this);
+    }
+
+    int fd_;
+    EventLoop* loop_;
+    size_t batchBytes_;
+    bool scheduled_;
+    bool retrying_;
+    std::error_code error_;
+    std::vector<char> buffer_;
+};
+
+/** Receiving end: reads frames from a connected stream socket and emits them on
+  a local signal. Either call receive() when the fd is readable or attach() it to
+  an EventLoop. The fd is not closed **/
+template<typename... args>
+class RemoteSignalReceiver
+{
+  public:
+    /** constructor **/
+    RemoteSignalReceiver(int fd, Signal<args...>& target)
+      : fd_(fd),
+      target_(target),
+      loop_(nullptr),
+      begin_(0),
+      end_(0)
+    {
+    }
+
+    /** destructor. Detaches from the loop **/
+    ~RemoteSignalReceiver()
+    {
+      detach();
+    }
+
+    /** watch the fd in loop and receive whenever it is readable. On end of stream
+      or a malformed frame the fd is unwatched. Loop thread only **/
+    void attach(EventLoop& loop)
+    {
+      detach();
+      loop_ = &loop;
+      loop.watch(fd_, EPOLLIN, [this](uint32_t)
+        {
+          bool open;
+          try
+          {
+            open = receive();
+          }
+          catch (const std::system_error&)
+          {
+            open = false;
+          }
+          if (!open)
+          {
+            detach();
+          }
+        });
+    }
+
+    /** stop watching the fd. Loop thread only **/
+    void detach()
+    {
+      if (loop_ != nullptr)
+      {
+        loop_->unwatch(fd_);
+        loop_ = nullptr;
+      }
+    }
+
+    /** read once from the fd and emit every complete frame. Returns false at end of
+      stream. Throws std::system_error on read errors and malformed frames **/
+    bool receive()
+    {
+      reserve();
+      ssize_t n;
+      do
+      {
+        n = ::read(fd_, &buffer_[end_], buffer_.size() - end_);
+      } while (n < 0 && errno == EINTR);
+      if (n < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          return true;
+        }
+        throw std::system_error(errno, std::system_category(), "read");
+      }
+      end_ += size_t(n);
+      deliver();
+      return n != 0;
+    }
+
+  private:
+    /** don't allow copy construction **/
+    RemoteSignalReceiver(const RemoteSignalReceiver& other);
+
+    /** don't allow copy assignment **/
+    RemoteSignalReceiver& operator= (RemoteSignalReceiver& other);
+
+    using tuple_type = typename ArgsSerializer<args...>::tuple_type;
+
+    static const size_t readSize = 65536;
+
+    /** make room for at least readSize bytes after end_ **/
+    void reserve()
+    {
+      if (buffer_.size() - end_ >= readSize)
+      {
+        return;
+      }
+      // move the partial frame to the front, then grow if that isn't enough
+      if (begin_ != 0)
+      {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+      }
+      if (buffer_.size() - end_ < readSize)
+      {
+        buffer_.resize(end_ + readSize);
+      }
+    }
+
+    void deliver()
+    {
+      for (;;)
+      {
+        const char* p = buffer_.data() + begin_;
+        const char* end = buffer_.data() + end_;
+        uint32_t payload;
+        const char* body = SerializeTraits<uint32_t>::read(p, end, payload);
+        if (body == nullptr || size_t(end - body) < payload)
+        {
+          break;
+        }
+        tuple_type t;
+        if (!ArgsSerializer<args...>::read(body, body + payload, t))
+        {
+          begin_ = end_ = 0;
+          throw std::system_error(EPROTO, std::system_category(), "malformed frame");
+        }
+        begin_ += sizeof(uint32_t) + payload;
+        emit(t, typename MakeIndexSequence<sizeof...(args)>::type());
+      }
+      if (begin_ == end_)
+      {
+        begin_ = end_ = 0;
+      }
+    }
+
+    template<unsigned... I>
+    void emit(tuple_type& t, IndexSequence<I...>)
+    {
+      target_(std::forward<args>(std::get<I>(t))...);
+    }
+
+    int fd_;
+    Signal<args...>& target_;
+    EventLoop* loop_;
+    /** bytes [begin_, end_) of buffer_ are received but not yet delivered **/
+    std::vector<char> buffer_;
+    size_t begin_;
+    size_t end_;
+};
+
+#endif // REMOTESIGNAL_H
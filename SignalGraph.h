@@ -0,0 +1,439 @@
+#ifndef SIGNALGRAPH_H
+#define SIGNALGRAPH_H
+
+#include "Signals.h"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/** Dependency graph of values with glitch-free change propagation.
+  Source nodes are set from the outside, derived nodes are computed from other nodes.
+  When sources change, derived nodes are recomputed in topological order, each at
+  most once per transaction, and only then are the changed() signals emitted.
+  Slots therefore never see a mix of old and new values.
+  Dependencies are fixed when a derived node is constructed and can only refer to
+  existing nodes, so the graph can't contain cycles **/
+
+/** forward declaration **/
+class SignalGraph;
+
+/** Interface for running the recomputes of one topological level.
+  Nodes of the same level don't depend on each other, so they can be recomputed
+  in any order or in parallel **/
+class AbstractScheduler
+{
+  public:
+    /** call job(i) for every i in [0, count) and return when all calls are done **/
+    virtual void run(size_t count, const std::function<void(size_t)>& job) = 0;
+    virtual ~AbstractScheduler() {}
+};
+
+/** node of a SignalGraph. Derived classes hold the actual value **/
+class GraphNode
+{
+  public:
+    /** topological level: 0 for sources, 1 + the highest dependency level otherwise **/
+    unsigned level() const
+    {
+      return level_;
+    }
+
+    /** destructor. Nodes must be destroyed before the nodes that depend on them **/
+    inline virtual ~GraphNode();
+
+  protected:
+    /** constructor **/
+    explicit GraphNode(SignalGraph& graph)
+      : graph_(graph),
+      level_(0),
+      scheduled_(false),
+      notifyPending_(false),
+      recomputed_(false)
+    {
+    }
+
+    /** declare that this node is computed from dependency **/
+    void dependsOn(GraphNode& dependency)
+    {
+      dependencies_.push_back(&dependency);
+      dependency.dependents_.push_back(this);
+      level_ = std::max(level_, dependency.level_ + 1);
+    }
+
+    /** report that this node's value changed (used by sources) **/
+    inline void touch();
+
+    /** recompute the value from the dependencies. Returns true if it changed **/
+    virtual bool recompute() = 0;
+
+    /** emit the change notification **/
+    virtual void notify() = 0;
+
+  private:
+    friend class SignalGraph;
+
+    /** don't allow copy construction **/
+    GraphNode(const GraphNode& other);
+
+    /** don't allow copy assignment **/
+    GraphNode& operator= (GraphNode& other);
+
+    SignalGraph& graph_;
+    unsigned level_;
+    std::vector<GraphNode*> dependencies_;
+    std::vector<GraphNode*> dependents_;
+    /** waiting for recompute() in a level bucket **/
+    bool scheduled_;
+    /** waiting for notify() **/
+    bool notifyPending_;
+    /** result of the last recompute(), for parallel levels **/
+    bool recomputed_;
+};
+
+/** propagation engine shared by a set of nodes **/
+class SignalGraph
+{
+  public:
+    /** constructor **/
+    SignalGraph()
+      : scheduler_(nullptr),
+      parallelThreshold_(0),
+      depth_(0),
+      propagating_(false),
+      recomputes_(0)
+    {
+    }
+
+    /** recompute levels with at least threshold scheduled nodes through scheduler,
+      for example a WorkStealingPool. Smaller levels, and all levels if scheduler is
+      nullptr, are recomputed in the calling thread. Slots are always notified in the
+      calling thread. Compute functions of nodes on parallel levels must not touch
+      anything but their dependencies **/
+    void scheduler(AbstractScheduler* scheduler, size_t threshold = 64)
+    {
+      scheduler_ = scheduler;
+      parallelThreshold_ = threshold;
+    }
+
+    /** start a transaction. Changes are propagated when the outermost transaction commits.
+      Outside of transactions, every change is propagated immediately **/
+    void begin()
+    {
+      depth_++;
+    }
+
+    /** end a transaction **/
+    void commit()
+    {
+      if (depth_ != 0 && --depth_ == 0)
+      {
+        propagate();
+      }
+    }
+
+    /** is a transaction open? **/
+    bool in_transaction() const
+    {
+      return (depth_ != 0);
+    }
+
+    /** total number of recompute() calls so far **/
+    unsigned long recomputes() const
+    {
+      return recomputes_;
+    }
+
+  private:
+    friend class GraphNode;
+
+    /** don't allow copy construction **/
+    SignalGraph(const SignalGraph& other);
+
+    /** don't allow copy assignment **/
+    SignalGraph& operator= (SignalGraph& other);
+
+    /** a node changed: notify it and schedule its dependents **/
+    void changed(GraphNode& node)
+    {
+      if (!node.notifyPending_)
+      {
+        node.notifyPending_ = true;
+        notify_.push_back(&node);
+      }
+      for (auto d : node.dependents_)
+      {
+        schedule(*d);
+      }
+    }
+
+    void schedule(GraphNode& node)
+    {
+      if (node.scheduled_)
+      {
+        return;
+      }
+      node.scheduled_ = true;
+      if (levels_.size() <= node.level_)
+      {
+        levels_.resize(node.level_ + 1);
+      }
+      levels_[node.level_].push_back(&node);
+    }
+
+    void touched(GraphNode& node)
+    {
+      changed(node);
+      if (depth_ == 0)
+      {
+        propagate();
+      }
+    }
+
+    /** recompute level by level, then notify in topological order.
+      Changes made by slots during notification start another round **/
+    void propagate()
+    {
+      if (propagating_)
+      {
+        return; // the running propagation picks it up
+      }
+      propagating_ = true;
+      while (!notify_.empty())
+      {
+        // buckets only receive nodes of higher levels while a level is processed,
+        // but levels_ may grow, so don't hold references into it
+        for (size_t level = 0; level < levels_.size(); level++)
+        {
+          if (scheduler_ != nullptr && levels_[level].size() >= parallelThreshold_)
+          {
+            // recompute in parallel, then schedule dependents serially
+            GraphNode* const* nodes = levels_[level].data();
+            scheduler_->run(levels_[level].size(), [nodes](size_t i)
+              {
+                nodes[i]->recomputed_ = nodes[i]->recompute();
+              });
+            recomputes_ += levels_[level].size();
+            for (size_t i = 0; i < levels_[level].size(); i++)
+            {
+              GraphNode* node = levels_[level][i];
+              node->scheduled_ = false;
+              if (node->recomputed_)
+              {
+                changed(*node);
+              }
+            }
+          }
+          else
+          {
+            for (size_t i = 0; i < levels_[level].size(); i++)
+            {
+              GraphNode* node = levels_[level][i];
+              node->scheduled_ = false;
+              recomputes_++;
+              if (node->recompute())
+              {
+                changed(*node);
+              }
+            }
+          }
+          levels_[level].clear();
+        }
+        // nodes were appended in level order
+        notifying_.swap(notify_);
+        for (size_t i = 0; i < notifying_.size(); i++)
+        {
+          GraphNode* node = notifying_[i];
+          if (node != nullptr)
+          {
+            node->notifyPending_ = false;
+            node->notify();
+          }
+        }
+        notifying_.clear();
+      }
+      propagating_ = false;
+    }
+
+    /** drop a node that is being destroyed from all pending work **/
+    void forget(GraphNode& node)
+    {
+      if (node.scheduled_)
+      {
+        std::vector<GraphNode*>& bucket = levels_[node.level_];
+        bucket.erase(std::remove(bucket.begin(), bucket.end(), &node), bucket.end());
+      }
+      if (node.notifyPending_)
+      {
+        notify_.erase(std::remove(notify_.begin(), notify_.end(), &node), notify_.end());
+      }
+      // may be destroyed by one of the slots currently being notified
+      std::replace(notifying_.begin(), notifying_.end(), &node, static_cast<GraphNode*>(nullptr));
+    }
+
+    AbstractScheduler* scheduler_;
+    size_t parallelThreshold_;
+    std::vector<std::vector<GraphNode*>> levels_;
+    std::vector<GraphNode*> notify_;
+    std::vector<GraphNode*> notifying_;
+    unsigned depth_;
+    bool propagating_;
+    unsigned long recomputes_;
+};
+
+void GraphNode::touch()
+{
+  graph_.touched(*this);
+}
+
+GraphNode::~GraphNode()
+{
+  graph_.forget(*this);
+  for (auto d : dependencies_)
+  {
+    auto& list = d->dependents_;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+  }
+}
+
+/** RAII guard that runs a graph transaction for its own lifetime **/
+class GraphTransaction
+{
+  public:
+    /** constructor. begins the transaction **/
+    explicit GraphTransaction(SignalGraph& graph)
+      : graph_(graph)
+    {
+      graph_.begin();
+    }
+
+    /** destructor. commits the transaction **/
+    ~GraphTransaction()
+    {
+      graph_.commit();
+    }
+
+  private:
+    /** don't allow copy construction **/
+    GraphTransaction(const GraphTransaction& other);
+
+    /** don't allow copy assignment **/
+    GraphTransaction& operator= (GraphTransaction& other);
+
+    SignalGraph& graph_;
+};
+
+/** node that is set from the outside **/
+template<typename T, typename Equal = std::equal_to<T>>
+class SourceNode : public GraphNode
+{
+  public:
+    /** constructor **/
+    explicit SourceNode(SignalGraph& graph, const T& value = T(), Equal equal = Equal())
+      : GraphNode(graph),
+      value_(value),
+      equal_(equal)
+    {
+    }
+
+    /** get the current value **/
+    const T& get() const
+    {
+      return value_;
+    }
+
+    /** set a new value. Dependents are updated if it differs from the old one **/
+    void set(const T& value)
+    {
+      if (equal_(value_, value))
+      {
+        return;
+      }
+      value_ = value;
+      touch();
+    }
+
+    /** signal emitted with the new value after propagation **/
+    Signal<const T&>& changed()
+    {
+      return changed_;
+    }
+
+  protected:
+    bool recompute() override
+    {
+      return false;
+    }
+
+    void notify() override
+    {
+      changed_(value_);
+    }
+
+  private:
+    T value_;
+    Equal equal_;
+    Signal<const T&> changed_;
+};
+
+/** node that is computed from other nodes **/
+template<typename T, typename Equal = std::equal_to<T>>
+class DerivedNode : public GraphNode
+{
+  public:
+    /** computation typedef. Reads the dependencies through their get() **/
+    using Compute = std::function<T()>;
+
+    /** constructor. Computes the initial value **/
+    DerivedNode(SignalGraph& graph, std::initializer_list<GraphNode*> dependencies,
+      Compute compute, Equal equal = Equal())
+      : GraphNode(graph),
+      compute_(std::move(compute)),
+      value_(compute_()),
+      equal_(equal)
+    {
+      for (auto d : dependencies)
+      {
+        dependsOn(*d);
+      }
+    }
+
+    /** get the current value **/
+    const T& get() const
+    {
+      return value_;
+    }
+
+    /** signal emitted with the new value after propagation **/
+    Signal<const T&>& changed()
+    {
+      return changed_;
+    }
+
+  protected:
+    bool recompute() override
+    {
+      T value = compute_();
+      if (equal_(value_, value))
+      {
+        return false;
+      }
+      value_ = std::move(value);
+      return true;
+    }
+
+    void notify() override
+    {
+      changed_(value_);
+    }
+
+  private:
+    Compute compute_;
+    T value_;
+    Equal equal_;
+    Signal<const T&> changed_;
+};
+
+#endif // SIGNALGRAPH_H
@@ -0,0 +1,316 @@
+#ifndef SIGNALMUX_H
+#define SIGNALMUX_H
+
+#include "Signals.h"
+
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/** Forwarding of several signals of different signatures over one channel.
+  SignalMux connects to a fixed list of signals and turns every emission into a
+  MuxPacket, a tagged union of the signals' argument tuples that lives entirely
+  in place (no heap allocation per emission). The packets are emitted by the mux's
+  own packets() signal, which can be connected to a queue, a serializer, etc.
+  On the receiving side SignalDemux re-emits a packet on the signal selected by
+  its tag through a jump table. Argument types must be values or const references **/
+
+/** stored argument tuple of a signal type **/
+template<typename Sig>
+struct SignalTuple;
+
+template<typename... args>
+struct SignalTuple<Signal<args...>>
+{
+  using type = std::tuple<typename std::decay<args>::type...>;
+};
+
+/** largest size and alignment of a list of types **/
+template<typename... T>
+struct MaxLayout
+{
+  static const size_t size = 1;
+  static const size_t align = 1;
+};
+
+template<typename T, typename... rest>
+struct MaxLayout<T, rest...>
+{
+  static const size_t size = (sizeof(T) > MaxLayout<rest...>::size) ? sizeof(T) : MaxLayout<rest...>::size;
+  static const size_t align = (alignof(T) > MaxLayout<rest...>::align) ? alignof(T) : MaxLayout<rest...>::align;
+};
+
+/** tagged union of the argument tuples of Sigs... **/
+template<typename... Sigs>
+class MuxPacket
+{
+  public:
+    static_assert(sizeof...(Sigs) > 0, "MuxPacket needs at least one signal type");
+
+    /** tuple type stored for the I-th signal **/
+    template<unsigned I>
+    using tuple_type = typename SignalTuple<typename std::tuple_element<I, std::tuple<Sigs...>>::type>::type;
+
+    /** index of an empty packet **/
+    static const unsigned empty = ~0u;
+
+    /** constructor. creates an empty packet **/
+    MuxPacket()
+      : index_(empty)
+    {
+    }
+
+    /** copy constructor **/
+    MuxPacket(const MuxPacket& other)
+      : index_(empty)
+    {
+      *this = other;
+    }
+
+    /** move constructor **/
+    MuxPacket(MuxPacket&& other)
+      : index_(empty)
+    {
+      *this = std::move(other);
+    }
+
+    /** copy assignment **/
+    MuxPacket& operator= (const MuxPacket& other)
+    {
+      if (this != &other)
+      {
+        reset();
+        if (other.index_ != empty)
+        {
+          copyAt(other.index_, &storage_, &other.storage_, Indices());
+          index_ = other.index_;
+        }
+      }
+      return *this;
+    }
+
+    /** move assignment **/
+    MuxPacket& operator= (MuxPacket&& other)
+    {
+      if (this != &other)
+      {
+        reset();
+        if (other.index_ != empty)
+        {
+          moveAt(other.index_, &storage_, &other.storage_, Indices());
+          index_ = other.index_;
+        }
+      }
+      return *this;
+    }
+
+    /** destructor **/
+    ~MuxPacket()
+    {
+      reset();
+    }
+
+    /** store the arguments of the I-th signal **/
+    template<unsigned I, typename... A>
+    void emplace(A&&... a)
+    {
+      reset();
+      new (&storage_) tuple_type<I>(std::forward<A>(a)...);
+      index_ = I;
+    }
+
+    /** index of the signal this packet belongs to, or empty **/
+    unsigned index() const
+    {
+      return index_;
+    }
+
+    /** stored arguments. I must be index() **/
+    template<unsigned I>
+    const tuple_type<I>& get() const
+    {
+      return *reinterpret_cast<const tuple_type<I>*>(&storage_);
+    }
+
+    /** destroy the stored arguments **/
+    void reset()
+    {
+      if (index_ != empty)
+      {
+        destroyAt(index_, &storage_, Indices());
+        index_ = empty;
+      }
+    }
+
+  private:
+    using Indices = typename MakeIndexSequence<sizeof...(Sigs)>::type;
+
+    template<unsigned I>
+    static void destroyOne(void* p)
+    {
+      static_cast<tuple_type<I>*>(p)->~tuple_type<I>();
+    }
+
+    template<unsigned I>
+    static void copyOne(void* to, const void* from)
+    {
+      new (to) tuple_type<I>(*static_cast<const tuple_type<I>*>(from));
+    }
+
+    template<unsigned I>
+    static void moveOne(void* to, void* from)
+    {
+      new (to) tuple_type<I>(std::move(*static_cast<tuple_type<I>*>(from)));
+    }
+
+    template<unsigned... I>
+    static void destroyAt(unsigned index, void* p, IndexSequence<I...>)
+    {
+      static void (* const table[])(void*) = {&destroyOne<I>...};
+      table[index](p);
+    }
+
+    template<unsigned... I>
+    static void copyAt(unsigned index, void* to, const void* from, IndexSequence<I...>)
+    {
+      static void (* const table[])(void*, const void*) = {&copyOne<I>...};
+      table[index](to, from);
+    }
+
+    template<unsigned... I>
+    static void moveAt(unsigned index, void* to, void* from, IndexSequence<I...>)
+    {
+      static void (* const table[])(void*, void*) = {&moveOne<I>...};
+      table[index](to, from);
+    }
+
+    using Layout = MaxLayout<typename SignalTuple<Sigs>::type...>;
+
+    typename std::aligned_storage<Layout::size, Layout::align>::type storage_;
+    unsigned index_;
+};
+
+/** packs emissions of a fixed list of signals into MuxPackets **/
+template<typename... Sigs>
+class SignalMux
+{
+  public:
+    /** packet typedef **/
+    using packet_type = MuxPacket<Sigs...>;
+
+    /** constructor. connects to all signals **/
+    explicit SignalMux(Sigs&... signals)
+    {
+      connectAll(std::tuple<Sigs&...>(signals...), typename MakeIndexSequence<sizeof...(Sigs)>::type());
+    }
+
+    /** signal that emits one packet per emission of any of the source signals **/
+    Signal<const packet_type&>& packets()
+    {
+      return packets_;
+    }
+
+  private:
+    /** don't allow copy construction **/
+    SignalMux(const SignalMux& other);
+
+    /** don't allow copy assignment **/
+    SignalMux& operator= (SignalMux& other);
+
+    /** type-erased receiver **/
+    class TapBase
+    {
+      public:
+        virtual ~TapBase() {}
+    };
+
+    /** receiver for the I-th signal **/
+    template<unsigned I, typename Sig>
+    class Tap;
+
+    template<unsigned I, typename... args>
+    class Tap<I, Signal<args...>> : public TapBase
+    {
+      public:
+        Tap(SignalMux& mux, Signal<args...>& signal)
+          : mux_(mux),
+          connection_(signal, *this, &Tap::fire)
+        {
+        }
+
+        /** the packet lives on the stack, so nested and concurrent emissions
+          each get their own **/
+        void fire(args... a)
+        {
+          packet_type packet;
+          packet.template emplace<I>(std::forward<args>(a)...);
+          mux_.packets_(packet);
+        }
+
+      private:
+        SignalMux& mux_;
+        Connection<args...> connection_;
+    };
+
+    template<unsigned... I>
+    void connectAll(std::tuple<Sigs&...> signals, IndexSequence<I...>)
+    {
+      int expand[] = {(taps_[I].reset(new Tap<I, Sigs>(*this, std::get<I>(signals))), 0)...};
+      (void)expand;
+    }
+
+    Signal<const packet_type&> packets_;
+    std::unique_ptr<TapBase> taps_[sizeof...(Sigs)];
+};
+
+/** re-emits MuxPackets on the signal selected by their tag **/
+template<typename... Sigs>
+class SignalDemux
+{
+  public:
+    /** packet typedef **/
+    using packet_type = MuxPacket<Sigs...>;
+
+    /** constructor **/
+    explicit SignalDemux(Sigs&... signals)
+      : signals_(signals...)
+    {
+    }
+
+    /** emit the packet's arguments on its signal. Empty packets are ignored **/
+    void dispatch(const packet_type& packet)
+    {
+      if (packet.index() != packet_type::empty)
+      {
+        dispatchAt(packet, typename MakeIndexSequence<sizeof...(Sigs)>::type());
+      }
+    }
+
+  private:
+    template<unsigned... I>
+    void dispatchAt(const packet_type& packet, IndexSequence<I...>)
+    {
+      static void (* const table[])(SignalDemux&, const packet_type&) = {&deliver<I>...};
+      table[packet.index()](*this, packet);
+    }
+
+    template<unsigned I>
+    static void deliver(SignalDemux& demux, const packet_type& packet)
+    {
+      const auto& t = packet.template get<I>();
+      emit(std::get<I>(demux.signals_), t,
+        typename MakeIndexSequence<std::tuple_size<typename std::decay<decltype(t)>::type>::value>::type());
+    }
+
+    template<typename Sig, typename Tuple, unsigned... J>
+    static void emit(Sig& signal, const Tuple& t, IndexSequence<J...>)
+    {
+      signal(std::get<J>(t)...);
+    }
+
+    std::tuple<Sigs&...> signals_;
+};
+
+#endif // SIGNALMUX_H
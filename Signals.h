@@ -1,15 +1,121 @@
 #ifndef SIGNALS_H
 #define SIGNALS_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
+/** branch prediction hint for paths that are rarely taken **/
+#if defined(__GNUC__)
+#define SIGNALS_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define SIGNALS_UNLIKELY(x) (x)
+#endif
+
+/** software prefetching during emission. Off by default, define SIGNALS_PREFETCH
+  to 1 to enable it once bench/PrefetchBench.cpp shows a gain on the target **/
+#ifndef SIGNALS_PREFETCH
+#define SIGNALS_PREFETCH 0
+#endif
+
+#if SIGNALS_PREFETCH && defined(__GNUC__)
+#define SIGNALS_PREFETCH_READ(p) __builtin_prefetch((p), 0, 3)
+#else
+#define SIGNALS_PREFETCH_READ(p) ((void)0)
+#endif
+
+/** compile-time index sequence, used to unpack stored argument tuples **/
+template<unsigned... I>
+struct IndexSequence
+{
+};
+
+/** builds IndexSequence<0, 1, ..., N-1> **/
+template<unsigned N, unsigned... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...>
+{
+};
+
+template<unsigned... I>
+struct MakeIndexSequence<0, I...>
+{
+  using type = IndexSequence<I...>;
+};
+
+/** FNV-1a hash over raw bytes, seed can be the hash of preceding bytes **/
+inline size_t hashBytes(const void* data, size_t size, size_t seed = 2166136261u)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  size_t h = seed;
+  for (size_t i = 0; i < size; i++)
+  {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+/** devirtualized call target: a plain function and the context it is called with.
+  Trivially copyable, so that it can be stored in arrays and inline in signals **/
+template<typename... args>
+struct DirectSlot
+{
+  /** thunk typedef **/
+  using thunk_type = void (*)(const void* context, args...);
+
+  void operator()(args... a) const
+  {
+    thunk(context, std::forward<args>(a)...);
+  }
+
+  const void* context;
+  thunk_type thunk;
+};
+
 /** Interface for delegates with a specific set of arguments **/
 template<typename... args>
 class AbstractDelegate
 {
   public:
     virtual void operator()(args...) const = 0;
+
+    /** direct call target for this delegate, valid as long as the delegate lives.
+      Defaults to a thunk that makes the virtual call **/
+    virtual DirectSlot<args...> slot() const
+    {
+      return DirectSlot<args...>{this, &callVirtual};
+    }
+
+    /** identifies the concrete delegate type without RTTI, nullptr if unknown **/
+    virtual const void* kind() const
+    {
+      return nullptr;
+    }
+
+    /** does other call the same target? Defaults to identity **/
+    virtual bool equals(const AbstractDelegate& other) const
+    {
+      return this == &other;
+    }
+
+    /** hash of the target, consistent with equals() **/
+    virtual size_t hash() const
+    {
+      const AbstractDelegate* self = this;
+      return hashBytes(&self, sizeof(self));
+    }
+
     virtual ~AbstractDelegate() {}
+
+  private:
+    static void callVirtual(const void* context, args... a)
+    {
+      (*static_cast<const AbstractDelegate*>(context))(std::forward<args>(a)...);
+    }
 };
 
 /** Concrete member function delegate that discards the function's return value **/
@@ -33,7 +139,48 @@ class ObjDelegate : public AbstractDelegate<args...>
       (obj_.*memFn_)(std::forward<args>(a)...);
     }
 
+    /** unique address per delegate type **/
+    static const void* tag()
+    {
+      static const char t = 0;
+      return &t;
+    }
+
+    const void* kind() const override
+    {
+      return tag();
+    }
+
+    /** same object and same member function? **/
+    bool equals(const AbstractDelegate<args...>& other) const override
+    {
+      if (other.kind() != tag())
+      {
+        return false;
+      }
+      const ObjDelegate& o = static_cast<const ObjDelegate&>(other);
+      return (&obj_ == &o.obj_) && (memFn_ == o.memFn_);
+    }
+
+    size_t hash() const override
+    {
+      const T* obj = &obj_;
+      return hashBytes(&memFn_, sizeof(memFn_), hashBytes(&obj, sizeof(obj)));
+    }
+
+    /** calls the member function without going through the vtable **/
+    DirectSlot<args...> slot() const override
+    {
+      return DirectSlot<args...>{this, &call};
+    }
+
   private:
+    static void call(const void* context, args... a)
+    {
+      const ObjDelegate* d = static_cast<const ObjDelegate*>(context);
+      (d->obj_.*(d->memFn_))(std::forward<args>(a)...);
+    }
+
     /** reference to the object **/
     T& obj_;
     /** member function pointer **/
@@ -60,7 +207,41 @@ class FnDelegate : public AbstractDelegate<args...>
       (*fn_)(std::forward<args>(a)...);
     }
 
+    /** unique address per delegate type **/
+    static const void* tag()
+    {
+      static const char t = 0;
+      return &t;
+    }
+
+    const void* kind() const override
+    {
+      return tag();
+    }
+
+    /** same function? **/
+    bool equals(const AbstractDelegate<args...>& other) const override
+    {
+      return (other.kind() == tag()) && (fn_ == static_cast<const FnDelegate&>(other).fn_);
+    }
+
+    size_t hash() const override
+    {
+      return hashBytes(&fn_, sizeof(fn_));
+    }
+
+    /** calls the function without going through the vtable **/
+    DirectSlot<args...> slot() const override
+    {
+      return DirectSlot<args...>{this, &call};
+    }
+
   private:
+    static void call(const void* context, args... a)
+    {
+      (*static_cast<const FnDelegate*>(context)->fn_)(std::forward<args>(a)...);
+    }
+
     /** function pointer **/
     const Fn fn_;
 };
@@ -69,7 +250,357 @@ class FnDelegate : public AbstractDelegate<args...>
 template<typename... args>
 class Connection;
 
-/** Signal class that can be connected to**/
+/** forward declaration **/
+class ConnectionGroup;
+
+/** forward declaration **/
+class Trackable;
+
+/** signature independent part of a connection, used for group membership **/
+class ConnectionBase
+{
+  public:
+    /** disconnect from the signal, if connected **/
+    virtual void disconnect() = 0;
+
+    /** get the group this connection belongs to, or nullptr **/
+    ConnectionGroup* group() const
+    {
+      return (links_ != nullptr) ? links_->group : nullptr;
+    }
+
+    /** is this connection's group blocked? **/
+    inline bool groupBlocked() const;
+
+  protected:
+    /** constructor **/
+    ConnectionBase()
+      : links_(nullptr)
+    {
+    }
+
+    /** register with a receiver that disconnects this connection when it is destroyed **/
+    void trackReceiver(Trackable* receiver)
+    {
+      track(*receiver);
+    }
+
+    /** receivers that don't derive from Trackable aren't tracked **/
+    void trackReceiver(const void*)
+    {
+    }
+
+    /** destructor. leaves the group and the receiver's list **/
+    inline virtual ~ConnectionBase();
+
+  private:
+    friend class ConnectionGroup;
+    friend class Trackable;
+
+    /** called after the connection joined or left a group **/
+    virtual void groupChanged()
+    {
+    }
+
+    /** group membership and receiver tracking, allocated when the connection first
+      joins a group or is tracked, so that plain connections stay small **/
+    struct Links
+    {
+      ConnectionGroup* group;
+      ConnectionBase* groupPrev;
+      ConnectionBase* groupNext;
+      Trackable* tracker;
+      ConnectionBase* trackPrev;
+      ConnectionBase* trackNext;
+    };
+
+    Links& links()
+    {
+      if (links_ == nullptr)
+      {
+        links_ = new Links{nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+      }
+      return *links_;
+    }
+
+    inline void track(Trackable& receiver);
+    inline void untrack();
+
+    Links* links_;
+};
+
+/** group of connections (a tag) that can be blocked, unblocked and disconnected as a whole.
+  Blocking is a single flag shared by all members and checked during emission,
+  so it takes effect for every member at once, no matter how many there are.
+  Connections of different signals and signatures can be members of the same group,
+  a connection can be member of at most one group **/
+class ConnectionGroup
+{
+  public:
+    /** constructor **/
+    ConnectionGroup()
+      : members_(nullptr),
+      blocked_(false)
+    {
+    }
+
+    /** add a connection to this group. It is removed from its previous group **/
+    void add(ConnectionBase& c)
+    {
+      if (c.group() != nullptr)
+      {
+        c.group()->remove(c);
+      }
+      ConnectionBase::Links& links = c.links();
+      links.group = this;
+      links.groupPrev = nullptr;
+      links.groupNext = members_;
+      if (members_ != nullptr)
+      {
+        members_->links_->groupPrev = &c;
+      }
+      members_ = &c;
+      c.groupChanged();
+    }
+
+    /** remove a connection from this group **/
+    void remove(ConnectionBase& c)
+    {
+      if (c.group() != this)
+      {
+        return;
+      }
+      ConnectionBase::Links& links = *c.links_;
+      if (links.groupPrev != nullptr)
+      {
+        links.groupPrev->links_->groupNext = links.groupNext;
+      }
+      else
+      {
+        members_ = links.groupNext;
+      }
+      if (links.groupNext != nullptr)
+      {
+        links.groupNext->links_->groupPrev = links.groupPrev;
+      }
+      links.group = nullptr;
+      links.groupPrev = nullptr;
+      links.groupNext = nullptr;
+      c.groupChanged();
+    }
+
+    /** block events for all members **/
+    void block()
+    {
+      blocked_ = true;
+    }
+
+    /** unblock events for all members. Members that are blocked individually stay blocked **/
+    void unblock()
+    {
+      blocked_ = false;
+    }
+
+    /** is this group blocked? **/
+    bool blocked() const
+    {
+      return blocked_;
+    }
+
+    /** disconnect all members from their signals. They remain members of this group **/
+    void disconnect()
+    {
+      for (ConnectionBase* c = members_; c != nullptr; c = c->links_->groupNext)
+      {
+        c->disconnect();
+      }
+    }
+
+    /** destructor. Removes all members, but doesn't disconnect them **/
+    ~ConnectionGroup()
+    {
+      while (members_ != nullptr)
+      {
+        remove(*members_);
+      }
+    }
+
+  private:
+    /** don't allow copy construction **/
+    ConnectionGroup(const ConnectionGroup& other);
+
+    /** don't allow copy assignment **/
+    ConnectionGroup& operator= (ConnectionGroup& other);
+
+    ConnectionBase* members_;
+    bool blocked_;
+};
+
+/** Base class for receivers. Connections to member functions of a Trackable are
+  registered in an intrusive list in the receiver, and the receiver's destructor
+  disconnects all of them in O(k) for k connections. This makes it safe to destroy
+  a receiver before its connections. Emission doesn't pay anything for this **/
+class Trackable
+{
+  public:
+    /** disconnect all connections to member functions of this object, across all signals.
+      Runs in O(k) for k connections, independent of the number of connections
+      the signals have. The connections stay registered with this object **/
+    void disconnect_all()
+    {
+      for (ConnectionBase* c = tracked_; c != nullptr; c = c->links_->trackNext)
+      {
+        c->disconnect();
+      }
+    }
+
+  protected:
+    /** constructor **/
+    Trackable()
+      : tracked_(nullptr)
+    {
+    }
+
+    /** copy constructor. Connections are not copied **/
+    Trackable(const Trackable&)
+      : tracked_(nullptr)
+    {
+    }
+
+    /** copy assignment. Connections are not copied **/
+    Trackable& operator= (const Trackable&)
+    {
+      return *this;
+    }
+
+    /** destructor. disconnects all connections to this receiver **/
+    ~Trackable()
+    {
+      while (tracked_ != nullptr)
+      {
+        ConnectionBase* c = tracked_;
+        c->untrack();
+        c->disconnect();
+      }
+    }
+
+  private:
+    friend class ConnectionBase;
+
+    ConnectionBase* tracked_;
+};
+
+bool ConnectionBase::groupBlocked() const
+{
+  return (links_ != nullptr) && (links_->group != nullptr) && links_->group->blocked();
+}
+
+void ConnectionBase::track(Trackable& receiver)
+{
+  Links& l = links();
+  l.tracker = &receiver;
+  l.trackPrev = nullptr;
+  l.trackNext = receiver.tracked_;
+  if (l.trackNext != nullptr)
+  {
+    l.trackNext->links_->trackPrev = this;
+  }
+  receiver.tracked_ = this;
+}
+
+void ConnectionBase::untrack()
+{
+  if (links_ == nullptr || links_->tracker == nullptr)
+  {
+    return;
+  }
+  Links& l = *links_;
+  if (l.trackPrev != nullptr)
+  {
+    l.trackPrev->links_->trackNext = l.trackNext;
+  }
+  else
+  {
+    l.tracker->tracked_ = l.trackNext;
+  }
+  if (l.trackNext != nullptr)
+  {
+    l.trackNext->links_->trackPrev = l.trackPrev;
+  }
+  l.tracker = nullptr;
+  l.trackPrev = nullptr;
+  l.trackNext = nullptr;
+}
+
+ConnectionBase::~ConnectionBase()
+{
+  if (group() != nullptr)
+  {
+    group()->remove(*this);
+  }
+  untrack();
+  delete links_;
+}
+
+/** Open addressing hash index from delegate targets to connections.
+  Used by signals in unique mode once they have many connections **/
+template<typename... args>
+class ConnectionIndex
+{
+  public:
+    /** connection pointer typedef **/
+    using connection_p = Connection<args...>*;
+
+    /** constructor **/
+    ConnectionIndex()
+      : entries_(nullptr),
+      capacity_(0),
+      size_(0)
+    {
+    }
+
+    /** destructor **/
+    ~ConnectionIndex()
+    {
+      delete[] entries_;
+    }
+
+    /** add a connection **/
+    inline void insert(connection_p c);
+
+    /** remove a connection **/
+    inline void erase(connection_p c);
+
+    /** find a connection whose delegate equals d **/
+    inline connection_p find(const AbstractDelegate<args...>& d) const;
+
+  private:
+    /** don't allow copy construction **/
+    ConnectionIndex(const ConnectionIndex& other);
+
+    /** don't allow copy assignment **/
+    ConnectionIndex& operator= (ConnectionIndex& other);
+
+    /** table entry, connection is nullptr for free entries **/
+    struct Entry
+    {
+      size_t hash;
+      connection_p connection;
+    };
+
+    inline void grow();
+
+    Entry* entries_;
+    size_t capacity_;
+    size_t size_;
+};
+
+/** Signal class that can be connected to.
+  Blocked connections are kept in a separate dormant list, so emission only
+  visits connections that are not blocked. Connections that are blocked or unblocked
+  while the signal emits change lists when the outermost emission returns.
+  Several threads may emit the same signal at once, as long as nothing connects,
+  disconnects, blocks or unblocks meanwhile **/
 template<typename... args>
 class Signal
 {
@@ -77,18 +608,35 @@ class Signal
     /** connection pointer typedef **/
     using connection_p = Connection<args...>*;
 
+    /** activation hook typedef. Receives the context passed to hooks() **/
+    using hook_fn = void (*)(void* context);
+
     /** constructor **/
     Signal()
-      : connections_(nullptr),
-      blocked_(false)
+      : single_{nullptr, nullptr},
+      connections_(nullptr),
+      dormant_(nullptr),
+      blockCount_(0),
+      emitting_(0),
+      relink_(false),
+      ext_(nullptr)
       {
       }
 
     /** copy constructor **/
     Signal(const Signal& other)
-      : connections_(nullptr),
-      blocked_(other.blocked()) // not sure if this is a good idea
+      : single_{nullptr, nullptr},
+      connections_(nullptr),
+      dormant_(nullptr),
+      blockCount_(other.blockCount_), // not sure if this is a good idea
+      emitting_(0),
+      relink_(false),
+      ext_(nullptr)
       {
+        if (other.unique())
+        {
+          unique(true);
+        }
       }
 
     /** call operator that notifes all connections associated with this Signal.
@@ -96,27 +644,99 @@ class Signal
     void operator()(args... a) const
     {
       // only notify connections if this signal is not blocked
-      if (!blocked())
+      if (SIGNALS_UNLIKELY(blocked()))
+      {
+        return;
+      }
+      // one active connection without a group: call it directly
+      if (single_.thunk != nullptr)
+      {
+        single_(std::forward<args>(a)...);
+        return;
+      }
+      Emitting guard(*this);
+      auto c = connections_;
+      while(c)
+      {
+        auto c_next = c->next();
+        if (c_next)
+        {
+          // while c runs, fetch the next delegate and the node after next
+          // (c_next itself was prefetched one iteration earlier)
+          SIGNALS_PREFETCH_READ(&c_next->delegate());
+          SIGNALS_PREFETCH_READ(c_next->next());
+          (*c)(a...);
+        }
+        else
+        {
+          (*c)(std::forward<args>(a)...); // last use, can forward
+        }
+        c = c_next;
+      }
+    }
+
+    /** emit with arguments produced by factory, which must return something that
+      converts to std::tuple of the decayed argument types. The factory is only called
+      if the emission reaches at least one connection. The arguments are constructed
+      once and shared by all connections **/
+    template<typename Factory>
+    void emit_lazy(Factory factory) const
+    {
+      if (!has_receivers())
       {
-        auto c = connections_;
-        while(c)
+        return;
+      }
+      std::tuple<typename std::decay<args>::type...> values(factory());
+      emitStored(values, typename MakeIndexSequence<sizeof...(args)>::type());
+    }
+
+    /** would an emission reach at least one connection? **/
+    bool has_receivers() const
+    {
+      if (blocked())
+      {
+        return false;
+      }
+      // the active list only holds connections that aren't blocked themselves
+      // (except while emitting), only their groups can still be blocked
+      for (auto c = connections_; c != nullptr; c = c->next())
+      {
+        if (!c->blocked() && !c->groupBlocked())
         {
-          auto c_next = c->next();
-          if (c_next)
-            (*c)(a...);
-          else
-            (*c)(std::forward<args>(a)...); // last use, can forward
-          c = c_next;
+          return true;
         }
       }
+      return false;
     }
 
-    /** connect to this signal **/
+    /** connect to this signal.
+      In unique mode, p is left unconnected if an equal delegate is already connected **/
     void connect(connection_p p)
     {
-      p->next_ = connections_;
-      connections_ = p;
+      if (unique() && find(p->delegate()) != nullptr)
+      {
+        return;
+      }
+      bool first = !has_connections();
+      link(p);
       p->signal_ = this;
+      if (ext_ == nullptr)
+      {
+        return;
+      }
+      ext_->count++;
+      if (ext_->index != nullptr)
+      {
+        ext_->index->insert(p);
+      }
+      else if (ext_->unique && ext_->count > indexThreshold)
+      {
+        buildIndex();
+      }
+      if (first && ext_->activated != nullptr)
+      {
+        ext_->activated(ext_->hookContext);
+      }
     }
 
     /** disconnect from this signal.
@@ -124,82 +744,394 @@ class Signal
       and removes the connection from the list **/
     void disconnect(connection_p conn)
     {
-      // find connection and remove it from the list
-      connection_p c = connections_;
-      if (c == conn)
+      if (conn->signal_ != this)
+      {
+        return;
+      }
+      unlink(conn);
+      conn->signal_ = nullptr;
+      if (ext_ == nullptr)
       {
-        connections_ = connections_->next();
-        conn->next_ = nullptr;
-        conn->signal_ = nullptr;
         return;
       }
-      while(c != nullptr)
+      ext_->count--;
+      if (ext_->index != nullptr)
+      {
+        ext_->index->erase(conn);
+      }
+      if (!has_connections() && ext_->deactivated != nullptr)
+      {
+        ext_->deactivated(ext_->hookContext);
+      }
+    }
+
+    /** find a connection, blocked or not, whose delegate equals d.
+      Linear in the number of connections, unless the hash index was built **/
+    connection_p find(const AbstractDelegate<args...>& d) const
+    {
+      if (ext_ != nullptr && ext_->index != nullptr)
+      {
+        return ext_->index->find(d);
+      }
+      for (auto list : {connections_, dormant_})
       {
-        if (c->next() == conn)
+        for (auto c = list; c != nullptr; c = c->next())
         {
-          c->next_ = conn->next();
-          conn->next_ = nullptr;
-          conn->signal_ = nullptr;
-          return;
+          if (c->delegate().equals(d))
+          {
+            return c;
+          }
         }
-        c = c->next();
       }
+      return nullptr;
     }
 
-    /** block events from this signal **/
+    /** find a connection to a non-static member function **/
+    template<typename T, typename ReturnType>
+    connection_p find(T& obj, ReturnType (T::*memFn)(args...)) const
+    {
+      return find(ObjDelegate<T, ReturnType, args...>(obj, memFn));
+    }
+
+    /** find a connection to a static member function or free function **/
+    template<typename ReturnType>
+    connection_p find(ReturnType (*fn)(args...)) const
+    {
+      return find(FnDelegate<ReturnType, args...>(fn));
+    }
+
+    /** enable or disable unique mode. In unique mode, connecting a target that is
+      already connected leaves the new connection unconnected. Once the signal has
+      more than indexThreshold connections, lookups go through a hash index **/
+    void unique(bool enable)
+    {
+      if (!enable && ext_ == nullptr)
+      {
+        return;
+      }
+      Extension& ext = extension();
+      ext.unique = enable;
+      if (enable && ext.index == nullptr && ext.count > indexThreshold)
+      {
+        buildIndex();
+      }
+      else if (!enable)
+      {
+        delete ext.index;
+        ext.index = nullptr;
+      }
+    }
+
+    /** is unique mode enabled? **/
+    bool unique() const
+    {
+      return (ext_ != nullptr) && ext_->unique;
+    }
+
+    /** number of connections, blocked or not.
+      Linear in the number of connections, unless hooks or unique mode are in use **/
+    unsigned count() const
+    {
+      return (ext_ != nullptr) ? ext_->count : countLists();
+    }
+
+    /** connection count above which unique mode builds a hash index **/
+    static const unsigned indexThreshold = 16;
+
+    /** does this signal have any connections, blocked or not?
+      Producers can use this to skip computing arguments, or to stop polling **/
+    bool has_connections() const
+    {
+      return (connections_ != nullptr) || (dormant_ != nullptr);
+    }
+
+    /** set hooks that are called when the first connection is made (activated)
+      and when the last one is removed (deactivated). Either can be nullptr.
+      The hooks are not called from the destructor **/
+    void hooks(hook_fn activated, hook_fn deactivated, void* context = nullptr)
+    {
+      Extension& ext = extension();
+      ext.activated = activated;
+      ext.deactivated = deactivated;
+      ext.hookContext = context;
+    }
+
+    /** block events from this signal.
+      Blocking nests: the signal stays blocked until unblock() was called as often as block() **/
     void block()
     {
-      blocked_ = true;
+      blockCount_++;
     }
 
-    /** unblock events from this signal **/
+    /** undo one block() **/
     void unblock()
     {
-      blocked_ = false;
+      if (blockCount_ != 0)
+      {
+        blockCount_--;
+      }
     }
 
     /** is this signal blocked? **/
     bool blocked() const
     {
-      return blocked_;
+      return (blockCount_ != 0);
     }
 
     /** destructor. disconnects all connections **/
     ~Signal()
     {
-      connection_p p = connections_;
-      while(p != nullptr)
+      if (ext_ != nullptr)
       {
-        connection_p n = p->next();
-        disconnect(p);
-        p = n;
+        ext_->deactivated = nullptr;
+      }
+      while(connections_ != nullptr)
+      {
+        disconnect(connections_);
+      }
+      while(dormant_ != nullptr)
+      {
+        disconnect(dormant_);
+      }
+      if (ext_ != nullptr)
+      {
+        delete ext_->index;
+        delete ext_;
       }
     }
 
+    /** connections that are not blocked, in emission order **/
     connection_p connections() const {return connections_;}
 
+    /** blocked connections **/
+    connection_p dormant_connections() const {return dormant_;}
+
+    friend class Connection<args...>;
   private:
     /** don't allow copy assignment **/
     Signal& operator= (Signal& other);
 
+    /** counts nested emissions. When the outermost one returns, connections that were
+      blocked or unblocked meanwhile are moved to their list. Moving them right away
+      could make the emission in progress skip the rest of the active list **/
+    struct Emitting
+    {
+      explicit Emitting(const Signal& signal)
+        : signal_(const_cast<Signal&>(signal))
+      {
+        signal_.emitting_.fetch_add(1, std::memory_order_acquire);
+      }
+
+      ~Emitting()
+      {
+        // only the emission that ends the last one relinks
+        if (signal_.emitting_.fetch_sub(1, std::memory_order_acq_rel) == 1 && signal_.relink_)
+        {
+          signal_.relinkBlocked();
+        }
+      }
+
+      Signal& signal_;
+    };
+
+    /** rarely used state, allocated when it is first set
+      so that signals which don't use it stay small **/
+    struct Extension
+    {
+      hook_fn activated;
+      hook_fn deactivated;
+      void* hookContext;
+      /** hash index of unique mode, built above indexThreshold connections **/
+      ConnectionIndex<args...>* index;
+      /** number of connections, kept up to date once the extension exists **/
+      unsigned count;
+      bool unique;
+    };
+
+    Extension& extension()
+    {
+      if (ext_ == nullptr)
+      {
+        ext_ = new Extension{nullptr, nullptr, nullptr, nullptr, countLists(), false};
+      }
+      return *ext_;
+    }
+
+    unsigned countLists() const
+    {
+      unsigned n = 0;
+      for (auto list : {connections_, dormant_})
+      {
+        for (auto c = list; c != nullptr; c = c->next())
+        {
+          n++;
+        }
+      }
+      return n;
+    }
+
+    template<unsigned... I>
+    void emitStored(std::tuple<typename std::decay<args>::type...>& t, IndexSequence<I...>) const
+    {
+      (*this)(std::forward<args>(std::get<I>(t))...);
+    }
+
+    void buildIndex()
+    {
+      ConnectionIndex<args...>* index = new ConnectionIndex<args...>();
+      ext_->index = index;
+      for (auto list : {connections_, dormant_})
+      {
+        for (auto c = list; c != nullptr; c = c->next())
+        {
+          index->insert(c);
+        }
+      }
+    }
+
+    /** list a connection belongs to, depending on its blocked state **/
+    connection_p& listOf(connection_p p)
+    {
+      return p->blocked_ ? dormant_ : connections_;
+    }
+
+    /** insert a connection at the head of its list **/
+    void link(connection_p p)
+    {
+      connection_p& head = listOf(p);
+      p->prev_ = nullptr;
+      p->next_ = head;
+      if (head != nullptr)
+      {
+        head->prev_ = p;
+      }
+      head = p;
+      refreshSingle();
+    }
+
+    /** remove a connection from its list. During an emission, the list may not
+      match the blocked state yet **/
+    void unlink(connection_p p)
+    {
+      if (p->prev_ != nullptr)
+      {
+        p->prev_->next_ = p->next_;
+      }
+      else if (connections_ == p)
+      {
+        connections_ = p->next_;
+      }
+      else
+      {
+        dormant_ = p->next_;
+      }
+      if (p->next_ != nullptr)
+      {
+        p->next_->prev_ = p->prev_;
+      }
+      p->prev_ = nullptr;
+      p->next_ = nullptr;
+      refreshSingle();
+    }
+
+    /** move connections that were blocked or unblocked during an emission to their list **/
+    void relinkBlocked()
+    {
+      relink_ = false;
+      for (connection_p c = connections_; c != nullptr; )
+      {
+        connection_p next = c->next_;
+        if (c->blocked_)
+        {
+          unlink(c);
+          link(c);
+        }
+        c = next;
+      }
+      for (connection_p c = dormant_; c != nullptr; )
+      {
+        connection_p next = c->next_;
+        if (!c->blocked_)
+        {
+          unlink(c);
+          link(c);
+        }
+        c = next;
+      }
+    }
+
+    /** cache the direct call target if exactly one connection is active and it
+      has no group (whose block flag would have to be checked on every emission) **/
+    void refreshSingle()
+    {
+      connection_p c = connections_;
+      if (c != nullptr && c->next_ == nullptr && !c->blocked_ && c->group() == nullptr)
+      {
+        single_ = c->delegate_->slot();
+      }
+      else
+      {
+        single_ = DirectSlot<args...>{nullptr, nullptr};
+      }
+    }
+
+    /** call target of the only active connection, see refreshSingle() **/
+    DirectSlot<args...> single_;
     connection_p connections_;
-    bool blocked_;
+    connection_p dormant_;
+    unsigned blockCount_;
+    /** emission depth over all threads, see Emitting **/
+    mutable std::atomic<unsigned short> emitting_;
+    /** set when a connection changed its blocked state during an emission **/
+    bool relink_;
+    Extension* ext_;
+};
+
+/** RAII guard that blocks a signal for its own lifetime. Guards can be nested **/
+template<typename... args>
+class SignalBlocker
+{
+  public:
+    /** constructor. blocks the signal **/
+    explicit SignalBlocker(Signal<args...>& signal)
+      : signal_(signal)
+    {
+      signal_.block();
+    }
+
+    /** destructor. undoes the block from the constructor **/
+    ~SignalBlocker()
+    {
+      signal_.unblock();
+    }
+
+  private:
+    /** don't allow copy construction **/
+    SignalBlocker(const SignalBlocker& other);
+
+    /** don't allow copy assignment **/
+    SignalBlocker& operator= (SignalBlocker& other);
+
+    Signal<args...>& signal_;
 };
 
 /** connection class that can be connected to a signal **/
 template<typename... args>
-class Connection
+class Connection : public ConnectionBase
 {
   public:
     /** template constructor for non-static member functions.
-      allocates a new delegate on the heap **/
+      allocates a new delegate on the heap.
+      If T derives from Trackable, obj disconnects this connection when it is destroyed **/
     template<typename T, typename ReturnType>
     Connection(Signal<args...>& signal, T& obj, ReturnType (T::*memFn)(args...))
       : delegate_(new ObjDelegate<T, ReturnType, args...>(obj, memFn)),
       signal_(nullptr),
+      prev_(nullptr),
       next_(nullptr),
       blocked_(false)
     {
+      trackReceiver(&obj);
       signal.connect(this);
     }
 
@@ -209,6 +1141,7 @@ class Connection
     Connection(Signal<args...>& signal, ReturnType (*Fn)(args...))
       : delegate_(new FnDelegate<ReturnType, args...>(Fn)),
       signal_(nullptr),
+      prev_(nullptr),
       next_(nullptr),
       blocked_(false)
     {
@@ -221,10 +1154,10 @@ class Connection
       return *delegate_;
     }
 
-    /** call this connection's delegate if not blocked **/
+    /** call this connection's delegate if neither it nor its group is blocked **/
     void operator()(args... a) const
     {
-      if (!blocked())
+      if (!blocked() && !groupBlocked())
       {
         delegate()(std::forward<args>(a)...);
       }
@@ -242,16 +1175,28 @@ class Connection
       return (signal_ != nullptr);
     }
 
-    /** block events for this connection **/
+    /** disconnect from the signal, if connected **/
+    void disconnect() override
+    {
+      if (signal_ != nullptr)
+      {
+        signal_->disconnect(this);
+      }
+    }
+
+    /** block events for this connection.
+      Moves it to the signal's dormant list, during an emission once that returns **/
     void block()
     {
-      blocked_ = true;
+      setBlocked(true);
     }
 
-    /** unblock events for this connection **/
+    /** unblock events for this connection.
+      Moves it back to the front of the signal's list of active connections,
+      during an emission once that returns **/
     void unblock()
     {
-      blocked_ = false;
+      setBlocked(false);
     }
 
     /** is this connection blocked? **/
@@ -280,12 +1225,139 @@ class Connection
     /** don't allow copy assignment **/
     Connection& operator= (Connection& other);
 
+    void groupChanged() override
+    {
+      if (signal_ != nullptr)
+      {
+        signal_->refreshSingle();
+      }
+    }
+
+    void setBlocked(bool blocked)
+    {
+      if (blocked_ == blocked)
+      {
+        return;
+      }
+      if (signal_ != nullptr && signal_->emitting_.load(std::memory_order_relaxed) != 0)
+      {
+        // the emission may be walking the list, operator() checks blocked_ meanwhile
+        blocked_ = blocked;
+        signal_->relink_ = true;
+        signal_->refreshSingle();
+      }
+      else if (signal_ != nullptr)
+      {
+        signal_->unlink(this);
+        blocked_ = blocked;
+        signal_->link(this);
+      }
+      else
+      {
+        blocked_ = blocked;
+      }
+    }
+
     AbstractDelegate<args...>* delegate_;
     Signal<args...>* signal_;
+    Connection* prev_;
     Connection* next_;
     bool blocked_;
 };
 
+template<typename... args>
+void ConnectionIndex<args...>::insert(connection_p c)
+{
+  if (2 * (size_ + 1) > capacity_)
+  {
+    grow();
+  }
+  size_t h = c->delegate().hash();
+  size_t i = h & (capacity_ - 1);
+  while (entries_[i].connection != nullptr)
+  {
+    i = (i + 1) & (capacity_ - 1);
+  }
+  entries_[i].hash = h;
+  entries_[i].connection = c;
+  size_++;
+}
+
+template<typename... args>
+void ConnectionIndex<args...>::erase(connection_p c)
+{
+  if (capacity_ == 0)
+  {
+    return;
+  }
+  size_t mask = capacity_ - 1;
+  size_t i = c->delegate().hash() & mask;
+  while (entries_[i].connection != c)
+  {
+    if (entries_[i].connection == nullptr)
+    {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  // backward shift deletion keeps probe sequences intact without tombstones
+  size_t j = i;
+  for (;;)
+  {
+    j = (j + 1) & mask;
+    if (entries_[j].connection == nullptr)
+    {
+      break;
+    }
+    size_t home = entries_[j].hash & mask;
+    // move j into the hole at i unless its home lies cyclically in (i, j]
+    bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (!stays)
+    {
+      entries_[i] = entries_[j];
+      i = j;
+    }
+  }
+  entries_[i].connection = nullptr;
+  size_--;
+}
+
+template<typename... args>
+Connection<args...>* ConnectionIndex<args...>::find(const AbstractDelegate<args...>& d) const
+{
+  if (size_ == 0)
+  {
+    return nullptr;
+  }
+  size_t h = d.hash();
+  for (size_t i = h & (capacity_ - 1); entries_[i].connection != nullptr; i = (i + 1) & (capacity_ - 1))
+  {
+    if (entries_[i].hash == h && entries_[i].connection->delegate().equals(d))
+    {
+      return entries_[i].connection;
+    }
+  }
+  return nullptr;
+}
+
+template<typename... args>
+void ConnectionIndex<args...>::grow()
+{
+  Entry* old = entries_;
+  size_t oldCapacity = capacity_;
+  capacity_ = (capacity_ == 0) ? 32 : 2 * capacity_;
+  entries_ = new Entry[capacity_]();
+  size_ = 0;
+  for (size_t i = 0; i < oldCapacity; i++)
+  {
+    if (old[i].connection != nullptr)
+    {
+      insert(old[i].connection);
+    }
+  }
+  delete[] old;
+}
+
 /** free connect function: creates a connection (non-static member function) on the heap
   that can be used anonymously **/
 template<typename T, typename ReturnType, typename... args>
@@ -0,0 +1,254 @@
+#ifndef SLOTMAPSIGNAL_H
+#define SLOTMAPSIGNAL_H
+
+#include "Signals.h"
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/** connection handle of a SlotMapSignal: index into the slot map and the generation
+  of the entry at the time of connect. Generation 0 is never used, so a
+  value-initialized handle refers to nothing **/
+struct SlotHandle
+{
+  uint32_t index;
+  uint32_t generation;
+
+  bool operator== (const SlotHandle& other) const
+  {
+    return index == other.index && generation == other.generation;
+  }
+
+  bool operator!= (const SlotHandle& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+static_assert(std::is_trivially_copyable<SlotHandle>::value && sizeof(SlotHandle) == 8,
+  "SlotHandle must stay a compact value type");
+
+/** Signal backed by a slot map. connect() returns a SlotHandle, disconnect() is O(1)
+  and ignores stale handles: the generation of an entry changes when it is freed,
+  so a handle to a disconnected slot never matches the entry's next user.
+  The DirectSlots are packed densely in connection order until a disconnect moves
+  the last one into the gap. Blocked slots stay in place with a null thunk.
+  Slots may connect, disconnect and block (themselves or others) while being notified:
+  disconnects during an emission only clear the slot, and the next connect or
+  disconnect after the emission compacts the array **/
+template<typename... args>
+class SlotMapSignal
+{
+  public:
+    /** connection handle **/
+    using handle = SlotHandle;
+
+    /** constructor **/
+    SlotMapSignal()
+      : dead_(0),
+      emitting_(0)
+    {
+    }
+
+    /** connect a non-static member function **/
+    template<typename T, typename ReturnType>
+    handle connect(T& obj, ReturnType (T::*memFn)(args...))
+    {
+      return add(new ObjDelegate<T, ReturnType, args...>(obj, memFn));
+    }
+
+    /** connect a static member function or free function **/
+    template<typename ReturnType>
+    handle connect(ReturnType (*fn)(args...))
+    {
+      return add(new FnDelegate<ReturnType, args...>(fn));
+    }
+
+    /** disconnect. Returns false if h is stale **/
+    bool disconnect(handle h)
+    {
+      if (!connected(h))
+      {
+        return false;
+      }
+      compact();
+      Entry& e = entries_[h.index];
+      uint32_t d = e.dense;
+      e.delegate.reset();
+      e.blocked = false;
+      e.generation = nextGeneration(e.generation);
+      free_.push_back(h.index);
+      if (emitting_ != 0)
+      {
+        slots_[d].thunk = nullptr;
+        owners_[d] = none;
+        dead_++;
+      }
+      else
+      {
+        removeAt(d);
+      }
+      return true;
+    }
+
+    /** is h connected to this signal? **/
+    bool connected(handle h) const
+    {
+      return h.index < entries_.size() && entries_[h.index].generation == h.generation
+        && entries_[h.index].delegate;
+    }
+
+    /** stop notifying h until unblock(). Stale handles are ignored **/
+    void block(handle h)
+    {
+      if (connected(h))
+      {
+        Entry& e = entries_[h.index];
+        e.blocked = true;
+        slots_[e.dense].thunk = nullptr;
+      }
+    }
+
+    /** notify h again. Stale handles are ignored **/
+    void unblock(handle h)
+    {
+      if (connected(h))
+      {
+        Entry& e = entries_[h.index];
+        e.blocked = false;
+        slots_[e.dense] = e.delegate->slot();
+      }
+    }
+
+    /** is h connected but blocked? **/
+    bool blocked(handle h) const
+    {
+      return connected(h) && entries_[h.index].blocked;
+    }
+
+    /** number of connected slots, blocked or not **/
+    unsigned count() const
+    {
+      return unsigned(slots_.size() - dead_);
+    }
+
+    /** notify all slots that aren't blocked **/
+    void operator()(args... a) const
+    {
+      Emitting guard(emitting_);
+      for (size_t i = 0; i < slots_.size(); i++)
+      {
+        DirectSlot<args...> slot = slots_[i]; // the array may grow during the call
+        if (slot.thunk != nullptr)
+        {
+          slot(a...);
+        }
+      }
+    }
+
+  private:
+    /** don't allow copy construction **/
+    SlotMapSignal(const SlotMapSignal& other);
+
+    /** don't allow copy assignment **/
+    SlotMapSignal& operator= (SlotMapSignal& other);
+
+    static const uint32_t none = ~uint32_t(0);
+
+    /** sparse entry, addressed by handle index **/
+    struct Entry
+    {
+      uint32_t dense;
+      uint32_t generation;
+      bool blocked;
+      std::unique_ptr<const AbstractDelegate<args...>> delegate;
+    };
+
+    /** keeps the emission depth right if a slot throws **/
+    struct Emitting
+    {
+      explicit Emitting(unsigned& depth) : depth_(depth) {depth_++;}
+      ~Emitting() {depth_--;}
+      unsigned& depth_;
+    };
+
+    static uint32_t nextGeneration(uint32_t generation)
+    {
+      return (generation == ~uint32_t(0)) ? 1 : (generation + 1);
+    }
+
+    handle add(const AbstractDelegate<args...>* delegate)
+    {
+      compact();
+      uint32_t index;
+      if (!free_.empty())
+      {
+        index = free_.back();
+        free_.pop_back();
+      }
+      else
+      {
+        index = uint32_t(entries_.size());
+        entries_.emplace_back();
+        entries_.back().generation = 1;
+      }
+      Entry& e = entries_[index];
+      e.dense = uint32_t(slots_.size());
+      e.blocked = false;
+      e.delegate.reset(delegate);
+      slots_.push_back(delegate->slot());
+      owners_.push_back(index);
+      return handle{index, e.generation};
+    }
+
+    /** move the last slot into position d **/
+    void removeAt(size_t d)
+    {
+      slots_[d] = slots_.back();
+      owners_[d] = owners_.back();
+      if (owners_[d] != none)
+      {
+        entries_[owners_[d]].dense = uint32_t(d);
+      }
+      slots_.pop_back();
+      owners_.pop_back();
+    }
+
+    /** remove the slots disconnected during emissions. Not during emission,
+      that could move a slot that hasn't been called yet in front of the current one **/
+    void compact()
+    {
+      if (dead_ == 0 || emitting_ != 0)
+      {
+        return;
+      }
+      size_t i = 0;
+      while (i < slots_.size())
+      {
+        if (owners_[i] != none)
+        {
+          i++;
+        }
+        else
+        {
+          removeAt(i);
+        }
+      }
+      dead_ = 0;
+    }
+
+    /** hot: read by every emission **/
+    std::vector<DirectSlot<args...>> slots_;
+
+    /** cold: dense index -> entry index, none for disconnected slots **/
+    std::vector<uint32_t> owners_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> free_;
+    /** disconnected slots that haven't been compacted yet **/
+    unsigned dead_;
+    mutable unsigned emitting_;
+};
+
+#endif // SLOTMAPSIGNAL_H
@@ -0,0 +1,228 @@
+#ifndef TRACEDSIGNAL_H
+#define TRACEDSIGNAL_H
+
+#include "Signals.h"
+
+#include <unistd.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/** timestamp source for traced emissions. Defaults to the TSC on x86 and to
+  CLOCK_MONOTONIC nanoseconds elsewhere. Can be overridden before including this header **/
+#ifndef SIGNALS_TRACE_CLOCK
+#if defined(__x86_64__) || defined(__i386__)
+#define SIGNALS_TRACE_CLOCK() (uint64_t(__rdtsc()))
+#else
+inline uint64_t signalsTraceClock()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+}
+#define SIGNALS_TRACE_CLOCK() signalsTraceClock()
+#endif
+#endif
+
+/** registry of all traced signals, so that a crash handler can dump them at once **/
+class TracedSignalBase
+{
+  public:
+    /** write the ring of every traced signal to fd. Async-signal-safe **/
+    static void dump_all(int fd)
+    {
+      for (const TracedSignalBase* t = head(); t != nullptr; t = t->nextTraced_)
+      {
+        t->dump(fd);
+      }
+    }
+
+    /** write the ring to fd, oldest record first, one line per record:
+      name, sequence number, timestamp and the argument bytes in hex.
+      Only uses write(2) and stack memory, so it is async-signal-safe **/
+    virtual void dump(int fd) const = 0;
+
+  protected:
+    /** constructor. registers with the list used by dump_all() **/
+    explicit TracedSignalBase(const char* name)
+      : name_(name),
+      nextTraced_(head())
+    {
+      head() = this;
+    }
+
+    /** destructor. unregisters **/
+    virtual ~TracedSignalBase()
+    {
+      for (TracedSignalBase** p = &head(); *p != nullptr; p = &(*p)->nextTraced_)
+      {
+        if (*p == this)
+        {
+          *p = nextTraced_;
+          break;
+        }
+      }
+    }
+
+    /** append at most max characters of text to a line buffer **/
+    static char* put(char* p, const char* text, size_t max = 32)
+    {
+      while (*text && max-- != 0)
+      {
+        *p++ = *text++;
+      }
+      return p;
+    }
+
+    /** append a number in hex, at least digits digits **/
+    static char* putHex(char* p, uint64_t value, int digits)
+    {
+      static const char hex[] = "0123456789abcdef";
+      char tmp[16];
+      int n = 0;
+      do
+      {
+        tmp[n++] = hex[value & 0xf];
+        value >>= 4;
+      } while (value != 0 || n < digits);
+      while (n > 0)
+      {
+        *p++ = tmp[--n];
+      }
+      return p;
+    }
+
+    static void writeAll(int fd, const char* data, size_t size)
+    {
+      while (size > 0)
+      {
+        ssize_t n = ::write(fd, data, size);
+        if (n <= 0)
+        {
+          return;
+        }
+        data += n;
+        size -= size_t(n);
+      }
+    }
+
+    const char* name_;
+
+  private:
+    /** don't allow copy construction **/
+    TracedSignalBase(const TracedSignalBase& other);
+
+    /** don't allow copy assignment **/
+    TracedSignalBase& operator= (TracedSignalBase& other);
+
+    static TracedSignalBase*& head()
+    {
+      static TracedSignalBase* h = nullptr;
+      return h;
+    }
+
+    TracedSignalBase* nextTraced_;
+};
+
+/** Signal that records its last N emissions (N a power of two) in a fixed ring:
+  a timestamp and the raw bytes of all arguments, which must be trivially copyable.
+  Recording costs a counter increment, a clock read and a few small memcpys.
+  Only emissions through the TracedSignal itself are recorded **/
+template<unsigned N, typename... args>
+class TracedSignal : public Signal<args...>, public TracedSignalBase
+{
+  public:
+    static_assert(N != 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+    /** constructor. name is used by dump() and must outlive the signal **/
+    explicit TracedSignal(const char* name = "signal")
+      : TracedSignalBase(name),
+      seq_(0)
+    {
+      std::memset(records_, 0, sizeof(records_));
+    }
+
+    /** record the emission, then notify all connections **/
+    void operator()(args... a) const
+    {
+      Record& r = records_[seq_.fetch_add(1, std::memory_order_relaxed) & (N - 1)];
+      r.timestamp = SIGNALS_TRACE_CLOCK();
+      unsigned char* p = r.bytes;
+      int expand[] = {0, (check<args>(), std::memcpy(p, &a, sizeof(a)), p += sizeof(a), 0)...};
+      (void)expand;
+      (void)p;
+      Signal<args...>::operator()(std::forward<args>(a)...);
+    }
+
+    /** number of emissions so far **/
+    uint32_t emissions() const
+    {
+      return seq_.load(std::memory_order_relaxed);
+    }
+
+    void dump(int fd) const override
+    {
+      uint32_t end = seq_.load(std::memory_order_acquire);
+      uint32_t begin = (end > N) ? (end - N) : 0;
+      for (uint32_t s = begin; s != end; s++)
+      {
+        const Record& r = records_[s & (N - 1)];
+        char line[64 + 3 * argBytes];
+        char* p = line;
+        p = put(p, name_);
+        p = put(p, " #");
+        p = putHex(p, s, 1);
+        p = put(p, " t=");
+        p = putHex(p, r.timestamp, 1);
+        for (size_t i = 0; i < argBytes; i++)
+        {
+          p = put(p, (i == 0) ? " " : ":");
+          p = putHex(p, r.bytes[i], 2);
+        }
+        p = put(p, "\n");
+        writeAll(fd, line, size_t(p - line));
+      }
+    }
+
+  private:
+    template<typename T>
+    static void check()
+    {
+      static_assert(std::is_trivially_copyable<typename std::decay<T>::type>::value,
+        "TracedSignal arguments must be trivially copyable");
+    }
+
+    /** sum of the argument sizes **/
+    template<typename... T>
+    struct Size
+    {
+      static const size_t value = 0;
+    };
+
+    template<typename T, typename... rest>
+    struct Size<T, rest...>
+    {
+      static const size_t value = sizeof(typename std::decay<T>::type) + Size<rest...>::value;
+    };
+
+    static const size_t argBytes = Size<args...>::value;
+
+    /** one recorded emission **/
+    struct Record
+    {
+      uint64_t timestamp;
+      unsigned char bytes[argBytes ? argBytes : 1];
+    };
+
+    mutable Record records_[N];
+    mutable std::atomic<uint32_t> seq_;
+};
+
+#endif // TRACEDSIGNAL_H
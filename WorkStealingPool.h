@@ -0,0 +1,199 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include "SignalGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Thread pool that runs the levels of a SignalGraph in parallel.
+  run() splits the index range into chunks and deals them out to per-worker deques.
+  Workers pop chunks from the back of their own deque and steal from the front of
+  the others' once it runs dry. The calling thread helps until all chunks are taken,
+  then waits for the last ones to finish **/
+class WorkStealingPool : public AbstractScheduler
+{
+  public:
+    /** constructor. threads is the number of workers besides the calling thread,
+      by default one less than the number of hardware threads **/
+    explicit WorkStealingPool(unsigned threads = defaultThreads())
+      : job_(nullptr),
+      queued_(0),
+      remaining_(0),
+      stopped_(false)
+    {
+      for (unsigned i = 0; i < threads + 1; i++)
+      {
+        queues_.emplace_back(new Queue());
+      }
+      for (unsigned i = 0; i < threads; i++)
+      {
+        workers_.emplace_back(&WorkStealingPool::work, this, i + 1);
+      }
+    }
+
+    /** destructor. Stops and joins the workers **/
+    ~WorkStealingPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+      }
+      wake_.notify_all();
+      for (auto& t : workers_)
+      {
+        t.join();
+      }
+    }
+
+    /** call job(i) for every i in [0, count). Not reentrant **/
+    void run(size_t count, const std::function<void(size_t)>& job) override
+    {
+      if (count == 0)
+      {
+        return;
+      }
+      // a few chunks per thread, so that stealing can even out unequal nodes
+      size_t chunk = std::max(size_t(1), count / (4 * queues_.size()));
+      size_t chunks = (count + chunk - 1) / chunk;
+      job_ = &job;
+      remaining_.store(chunks);
+      {
+        // count first, a worker may take a chunk as soon as it is pushed
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_ = chunks;
+      }
+      for (size_t c = 0; c < chunks; c++)
+      {
+        Queue& q = *queues_[c % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.ranges.push_back(Range{c * chunk, std::min(count, (c + 1) * chunk)});
+      }
+      wake_.notify_all();
+
+      Range r;
+      while (take(0, r))
+      {
+        execute(r);
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] {return remaining_.load() == 0;});
+      job_ = nullptr;
+    }
+
+    /** number of threads that execute chunks, including the calling one **/
+    unsigned concurrency() const
+    {
+      return unsigned(queues_.size());
+    }
+
+    static unsigned defaultThreads()
+    {
+      unsigned n = std::thread::hardware_concurrency();
+      return (n > 1) ? (n - 1) : 0;
+    }
+
+  private:
+    /** don't allow copy construction **/
+    WorkStealingPool(const WorkStealingPool& other);
+
+    /** don't allow copy assignment **/
+    WorkStealingPool& operator= (WorkStealingPool& other);
+
+    /** index range [begin, end) **/
+    struct Range
+    {
+      size_t begin;
+      size_t end;
+    };
+
+    /** per-thread deque of ranges. Index 0 belongs to the thread calling run() **/
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<Range> ranges;
+    };
+
+    /** take a chunk from the own queue, or steal one from another queue **/
+    bool take(size_t self, Range& r)
+    {
+      for (size_t i = 0; i < queues_.size(); i++)
+      {
+        Queue& q = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.ranges.empty())
+        {
+          continue;
+        }
+        if (i == 0)
+        {
+          r = q.ranges.back();
+          q.ranges.pop_back();
+        }
+        else
+        {
+          r = q.ranges.front();
+          q.ranges.pop_front();
+        }
+        std::lock_guard<std::mutex> count(mutex_);
+        queued_--;
+        return true;
+      }
+      return false;
+    }
+
+    void execute(const Range& r)
+    {
+      for (size_t i = r.begin; i < r.end; i++)
+      {
+        (*job_)(i);
+      }
+      if (remaining_.fetch_sub(1) == 1)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+      }
+    }
+
+    /** worker thread **/
+    void work(size_t self)
+    {
+      for (;;)
+      {
+        Range r;
+        if (take(self, r))
+        {
+          execute(r);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] {return stopped_ || queued_ != 0;});
+        if (stopped_)
+        {
+          return;
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    const std::function<void(size_t)>* job_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    /** chunks that are still in a queue, guarded by mutex_ **/
+    size_t queued_;
+    /** chunks that haven't finished yet **/
+    std::atomic<size_t> remaining_;
+    bool stopped_;
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -0,0 +1,101 @@
+/** emission cost of AdaptiveSignal against the fixed layouts for several fan-outs:
+  the Signal connection list, BitmapSignal and SlotMapSignal. Reports ns per
+  emission, to show the gap between the adaptive layout and the best fixed one at every size.
+  Build: g++ -std=c++11 -O2 -I.. AdaptiveSignalBench.cpp -o AdaptiveSignalBench **/
+
+#include "AdaptiveSignal.h"
+#include "Bench.h"
+#include "BitmapSignal.h"
+#include "SlotMapSignal.h"
+
+#include <cstdlib>
+#include <memory>
+
+struct Receiver
+{
+  uint64_t sum;
+
+  void onValue(int value)
+  {
+    sum += unsigned(value);
+  }
+};
+
+/** connection list, connections owned by the caller **/
+struct ListSignal
+{
+  Signal<int> signal;
+  std::vector<std::unique_ptr<Connection<int>>> connections;
+
+  void connect(Receiver& r)
+  {
+    connections.emplace_back(new Connection<int>(signal, r, &Receiver::onValue));
+  }
+
+  void operator()(int value) const
+  {
+    signal(value);
+  }
+};
+
+template<typename S>
+struct Handles
+{
+  S signal;
+
+  void connect(Receiver& r)
+  {
+    signal.connect(r, &Receiver::onValue);
+  }
+
+  void operator()(int value) const
+  {
+    signal(value);
+  }
+};
+
+template<typename S>
+static double measure(unsigned fanOut, uint64_t slotCalls)
+{
+  std::vector<Receiver> receivers(fanOut, Receiver{0});
+  std::unique_ptr<S> s(new S());
+  for (Receiver& r : receivers)
+  {
+    s->connect(r);
+  }
+  uint64_t emissions = slotCalls / (fanOut == 0 ? 1 : fanOut);
+  int64_t best = 0;
+  for (int round = 0; round < 3; round++)
+  {
+    int64_t start = benchNow();
+    for (uint64_t i = 0; i < emissions; i++)
+    {
+      (*s)(int(i));
+    }
+    int64_t elapsed = benchNow() - start;
+    best = (round == 0 || elapsed < best) ? elapsed : best;
+  }
+  uint64_t check = 0;
+  for (const Receiver& r : receivers)
+  {
+    check += r.sum;
+  }
+  benchKeep(check);
+  return double(best) / double(emissions);
+}
+
+int main(int argc, char** argv)
+{
+  uint64_t slotCalls = (argc > 1) ? uint64_t(std::atoll(argv[1])) : 20000000;
+  const unsigned sizes[] = {0, 1, 2, 5, 8, 16, 64, 500, 5000};
+  std::printf("%8s %12s %12s %12s %12s   (ns per emission)\n", "fan-out", "adaptive", "list", "bitmap", "slotmap");
+  for (unsigned n : sizes)
+  {
+    std::printf("%8u %12.2f %12.2f %12.2f %12.2f\n", n,
+      measure<Handles<AdaptiveSignal<int>>>(n, slotCalls),
+      measure<ListSignal>(n, slotCalls),
+      measure<Handles<BitmapSignal<int>>>(n, slotCalls),
+      measure<Handles<SlotMapSignal<int>>>(n, slotCalls));
+  }
+  return 0;
+}
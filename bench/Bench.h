@@ -0,0 +1,49 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/** helpers shared by the benchmarks in this directory. Each benchmark is a single
+  source file, see its header comment for the build line **/
+
+/** steady clock in nanoseconds **/
+inline int64_t benchNow()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** keep the compiler from optimizing a value away **/
+template<typename T>
+inline void benchKeep(const T& value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/** print p50/p99/p999 and max of latency samples in nanoseconds **/
+inline void benchPercentiles(const char* label, std::vector<int64_t> samples)
+{
+  if (samples.empty())
+  {
+    std::printf("%-32s no samples\n", label);
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto at = [&samples](double q) {return samples[size_t(q * double(samples.size() - 1))];};
+  std::printf("%-32s p50 %8lld ns  p99 %8lld ns  p999 %8lld ns  max %8lld ns\n", label,
+    (long long)at(0.5), (long long)at(0.99), (long long)at(0.999), (long long)samples.back());
+}
+
+/** print a throughput figure **/
+inline void benchRate(const char* label, uint64_t count, int64_t elapsedNs)
+{
+  std::printf("%-32s %10.2f M/s  (%llu in %.1f ms)\n", label,
+    elapsedNs > 0 ? double(count) * 1e3 / double(elapsedNs) : 0.0,
+    (unsigned long long)count, double(elapsedNs) / 1e6);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,85 @@
+/** delivery latency of queued emissions with and without busy polling.
+  A producer thread emits a timestamp, waits for the loop to deliver it and then
+  for a fixed gap, for several gaps below and above the spin limit. Reports p50,
+  p99 and p999 of emit-to-slot latency and the spin budget the loop settled on.
+  Needs at least two cores, with one core the spinning loop and the producer
+  take turns and the numbers are meaningless.
+  Build: g++ -std=c++11 -O2 -I.. BusyPollBench.cpp -o BusyPollBench -pthread **/
+
+#include "Bench.h"
+#include "EventLoop.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+struct Receiver
+{
+  EventLoop* loop;
+  std::vector<int64_t> samples;
+  uint64_t expected;
+  std::atomic<uint64_t> received;
+
+  void onStamp(int64_t sent)
+  {
+    samples.push_back(benchNow() - sent);
+    uint64_t n = received.load(std::memory_order_relaxed) + 1;
+    received.store(n, std::memory_order_release);
+    if (n == expected)
+    {
+      loop->stop();
+    }
+  }
+};
+
+static void run(std::chrono::nanoseconds spinLimit, std::chrono::nanoseconds gap, unsigned count)
+{
+  EventLoop loop;
+  loop.busy_poll(spinLimit);
+  Signal<int64_t> signal;
+  Receiver r;
+  r.loop = &loop;
+  r.expected = count;
+  r.received = 0;
+  r.samples.reserve(count);
+  Connection<int64_t> c(signal, r, &Receiver::onStamp);
+  QueuedSignal<int64_t> queue(loop, signal);
+  std::thread producer([&]()
+  {
+    for (unsigned i = 0; i < count; i++)
+    {
+      int64_t until = benchNow() + gap.count();
+      while (benchNow() < until)
+      {
+      }
+      queue(benchNow());
+      while (r.received.load(std::memory_order_acquire) <= i)
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+  loop.run();
+  producer.join();
+  std::string label = "spin " + std::to_string(spinLimit.count() / 1000) + " us, gap "
+    + std::to_string(gap.count() / 1000) + " us";
+  benchPercentiles(label.c_str(), r.samples);
+  std::printf("%-32s budget %lld ns\n", "", (long long)loop.spin_budget().count());
+}
+
+int main(int argc, char** argv)
+{
+  unsigned count = (argc > 1) ? unsigned(std::atoi(argv[1])) : 20000;
+  const std::chrono::nanoseconds limits[] = {std::chrono::nanoseconds(0), std::chrono::microseconds(50)};
+  const std::chrono::nanoseconds gaps[] = {std::chrono::microseconds(2), std::chrono::microseconds(10),
+    std::chrono::microseconds(200)};
+  for (std::chrono::nanoseconds limit : limits)
+  {
+    for (std::chrono::nanoseconds gap : gaps)
+    {
+      run(limit, gap, count);
+    }
+  }
+  return 0;
+}
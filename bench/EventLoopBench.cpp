@@ -0,0 +1,123 @@
+/** wakeup latency and throughput of queued signal delivery, epoll vs io_uring backend.
+  latency: a producer thread emits one timestamp at a time and waits for the loop to
+  park again before the next one, so every sample includes a full wakeup.
+  throughput: the producer emits as fast as it can, the loop drains in batches.
+  Build: g++ -std=c++11 -O2 -I.. EventLoopBench.cpp -o EventLoopBench -pthread **/
+
+#include "Bench.h"
+#include "EventLoop.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+struct Receiver
+{
+  EventLoop* loop;
+  std::vector<int64_t> samples;
+  uint64_t expected;
+  uint64_t received;
+  std::atomic<uint64_t> done;
+
+  void onStamp(int64_t sent)
+  {
+    samples.push_back(benchNow() - sent);
+    received++;
+    done.store(received, std::memory_order_release);
+    if (received == expected)
+    {
+      loop->stop();
+    }
+  }
+
+  void onCount(int64_t)
+  {
+    if (++received == expected)
+    {
+      loop->stop();
+    }
+  }
+};
+
+static const char* name(EventLoop::Backend backend)
+{
+  return backend == EventLoop::Backend::uring ? "uring" : "epoll";
+}
+
+static void latency(EventLoop::Backend backend, unsigned count)
+{
+  EventLoop loop(backend);
+  Signal<int64_t> signal;
+  Receiver r;
+  r.loop = &loop;
+  r.expected = count;
+  r.received = 0;
+  r.done = 0;
+  r.samples.reserve(count);
+  Connection<int64_t> c(signal, r, &Receiver::onStamp);
+  QueuedSignal<int64_t> queue(loop, signal);
+  std::thread producer([&]()
+  {
+    for (unsigned i = 0; i < count; i++)
+    {
+      // give the loop time to park in the poller
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      queue(benchNow());
+      while (r.done.load(std::memory_order_acquire) <= i)
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+  loop.run();
+  producer.join();
+  std::string label = std::string(name(backend)) + " wakeup latency";
+  benchPercentiles(label.c_str(), r.samples);
+}
+
+static void throughput(EventLoop::Backend backend, unsigned count)
+{
+  EventLoop loop(backend);
+  Signal<int64_t> signal;
+  Receiver r;
+  r.loop = &loop;
+  r.expected = count;
+  r.received = 0;
+  r.done = 0;
+  Connection<int64_t> c(signal, r, &Receiver::onCount);
+  QueuedSignal<int64_t> queue(loop, signal);
+  int64_t start = benchNow();
+  std::thread producer([&]()
+  {
+    for (unsigned i = 0; i < count; i++)
+    {
+      queue(int64_t(i));
+    }
+  });
+  loop.run();
+  int64_t elapsed = benchNow() - start;
+  producer.join();
+  std::string label = std::string(name(backend)) + " throughput";
+  benchRate(label.c_str(), count, elapsed);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned pings = (argc > 1) ? unsigned(std::atoi(argv[1])) : 20000;
+  unsigned events = (argc > 2) ? unsigned(std::atoi(argv[2])) : 2000000;
+  const EventLoop::Backend backends[] = {EventLoop::Backend::epoll, EventLoop::Backend::uring};
+  for (EventLoop::Backend backend : backends)
+  {
+    try
+    {
+      latency(backend, pings);
+      throughput(backend, events);
+    }
+    catch (const std::system_error& e)
+    {
+      std::printf("%s: not available (%s)\n", name(backend), e.what());
+    }
+  }
+  return 0;
+}
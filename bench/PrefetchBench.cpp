@@ -0,0 +1,91 @@
+/** emission over cold, fragmented connection lists, with and without prefetching.
+  Many signals get a few connections each, allocated in random order with random
+  sized allocations in between, so list neighbours are far apart in memory. The
+  signals are emitted in random order over a working set much larger than the
+  last level cache, so nearly every node and delegate is a cache miss.
+  SIGNALS_PREFETCH is a compile-time switch, build and run both variants:
+  Build: g++ -std=c++11 -O2 -I.. -DSIGNALS_PREFETCH=1 PrefetchBench.cpp -o PrefetchOn
+         g++ -std=c++11 -O2 -I.. -DSIGNALS_PREFETCH=0 PrefetchBench.cpp -o PrefetchOff **/
+
+#include "Bench.h"
+#include "Signals.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+struct Receiver
+{
+  uint64_t sum;
+
+  void onValue(uint64_t value)
+  {
+    for (unsigned i = 0; i < work; i++)
+    {
+      value = value * 0x9e3779b97f4a7c15ULL + i;
+    }
+    sum += value;
+  }
+
+  static unsigned work;
+};
+
+unsigned Receiver::work = 0;
+
+int main(int argc, char** argv)
+{
+  unsigned signals = (argc > 1) ? unsigned(std::atoi(argv[1])) : 65536;
+  unsigned fanOut = (argc > 2) ? unsigned(std::atoi(argv[2])) : 16;
+  unsigned rounds = (argc > 3) ? unsigned(std::atoi(argv[3])) : 4;
+  Receiver::work = (argc > 4) ? unsigned(std::atoi(argv[4])) : 8;
+
+  std::mt19937 random(12345);
+  std::vector<Signal<uint64_t>> sigs(signals);
+  std::vector<Receiver> receivers(signals, Receiver{0});
+  std::vector<std::unique_ptr<Connection<uint64_t>>> connections;
+  std::vector<std::unique_ptr<char[]>> padding;
+  // connect in random signal order, so a signal's connections are scattered
+  std::vector<unsigned> order;
+  for (unsigned s = 0; s < signals; s++)
+  {
+    for (unsigned k = 0; k < fanOut; k++)
+    {
+      order.push_back(s);
+    }
+  }
+  std::shuffle(order.begin(), order.end(), random);
+  for (unsigned s : order)
+  {
+    padding.emplace_back(new char[64 + random() % 448]);
+    connections.emplace_back(new Connection<uint64_t>(sigs[s], receivers[s], &Receiver::onValue));
+  }
+  std::vector<unsigned> emitOrder(signals);
+  for (unsigned s = 0; s < signals; s++)
+  {
+    emitOrder[s] = s;
+  }
+  std::shuffle(emitOrder.begin(), emitOrder.end(), random);
+
+  int64_t best = 0;
+  for (unsigned r = 0; r < rounds; r++)
+  {
+    int64_t start = benchNow();
+    for (unsigned s : emitOrder)
+    {
+      sigs[s](s);
+    }
+    int64_t elapsed = benchNow() - start;
+    best = (r == 0 || elapsed < best) ? elapsed : best;
+  }
+  uint64_t calls = uint64_t(signals) * fanOut;
+  std::printf("SIGNALS_PREFETCH=%d  %u signals x %u connections, work %u: %.2f ns per slot call (best of %u)\n",
+    SIGNALS_PREFETCH, signals, fanOut, Receiver::work, double(best) / double(calls), rounds);
+  uint64_t check = 0;
+  for (const Receiver& rc : receivers)
+  {
+    check += rc.sum;
+  }
+  benchKeep(check);
+  return 0;
+}
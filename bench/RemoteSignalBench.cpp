@@ -0,0 +1,74 @@
+/** RemoteSignal throughput over a Unix domain socket pair: one write() per event
+  (batch size 1) against batched writes of several sizes. A receiver thread emits
+  every frame on a local signal, the time is taken until it has seen all of them.
+  Build: g++ -std=c++11 -O2 -I.. RemoteSignalBench.cpp -o RemoteSignalBench -pthread **/
+
+#include "Bench.h"
+#include "RemoteSignal.h"
+
+#include <sys/socket.h>
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+struct Counter
+{
+  uint64_t frames;
+  uint64_t bytes;
+
+  void onEvent(int id, double value, const std::string& tag)
+  {
+    frames++;
+    bytes += tag.size();
+    benchKeep(id);
+    benchKeep(value);
+  }
+};
+
+static void run(size_t batchBytes, unsigned count)
+{
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+  {
+    throw std::system_error(errno, std::system_category(), "socketpair");
+  }
+  Signal<int, double, const std::string&> received;
+  Counter counter{0, 0};
+  Connection<int, double, const std::string&> c(received, counter, &Counter::onEvent);
+  RemoteSignalReceiver<int, double, const std::string&> receiver(fds[1], received);
+  std::thread reader([&receiver]()
+  {
+    while (receiver.receive())
+    {
+    }
+  });
+  const std::string tag("sensor/temperature");
+  int64_t start = benchNow();
+  {
+    RemoteSignalSender<int, double, const std::string&> sender(fds[0], batchBytes);
+    for (unsigned i = 0; i < count; i++)
+    {
+      sender(int(i), i * 0.5, tag);
+    }
+  }
+  ::shutdown(fds[0], SHUT_WR);
+  reader.join();
+  int64_t elapsed = benchNow() - start;
+  std::string label = (batchBytes <= 1) ? std::string("per-event write()")
+    : "batch " + std::to_string(batchBytes) + " bytes";
+  benchRate(label.c_str(), counter.frames, elapsed);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned count = (argc > 1) ? unsigned(std::atoi(argv[1])) : 1000000;
+  const size_t batches[] = {1, 512, 4096, 16384, 65536};
+  for (size_t batch : batches)
+  {
+    run(batch, count);
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/** propagation through a 10k node SignalGraph, serial vs WorkStealingPool.
+  One source feeds a level of 100 nodes, which feeds a level of 9899 nodes that
+  each depend on two nodes of the first level. Every transaction changes the source,
+  so all 9999 derived nodes recompute once. The cost of a recompute is set by the
+  work argument (iterations of an integer hash).
+  Build: g++ -std=c++11 -O2 -I.. SignalGraphBench.cpp -o SignalGraphBench -pthread **/
+
+#include "Bench.h"
+#include "SignalGraph.h"
+#include "WorkStealingPool.h"
+
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+static uint64_t burn(uint64_t x, unsigned work)
+{
+  for (unsigned i = 0; i < work; i++)
+  {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+  }
+  return x;
+}
+
+static void run(const char* label, AbstractScheduler* scheduler, unsigned transactions, unsigned work)
+{
+  const unsigned wide = 100;
+  const unsigned nodes = 10000;
+  SignalGraph graph;
+  graph.scheduler(scheduler);
+  SourceNode<uint64_t> source(graph, 1);
+  std::vector<std::unique_ptr<DerivedNode<uint64_t>>> first;
+  std::vector<std::unique_ptr<DerivedNode<uint64_t>>> second;
+  for (unsigned i = 0; i < wide; i++)
+  {
+    first.emplace_back(new DerivedNode<uint64_t>(graph, {&source},
+      [&source, i, work]() {return burn(source.get() + i, work);}));
+  }
+  for (unsigned i = 0; first.size() + second.size() + 1 < nodes; i++)
+  {
+    DerivedNode<uint64_t>* a = first[i % wide].get();
+    DerivedNode<uint64_t>* b = first[(i * 7 + 3) % wide].get();
+    second.emplace_back(new DerivedNode<uint64_t>(graph, {a, b},
+      [a, b, work]() {return burn(a->get() ^ b->get(), work);}));
+  }
+  uint64_t before = graph.recomputes();
+  int64_t start = benchNow();
+  for (unsigned t = 0; t < transactions; t++)
+  {
+    source.set(source.get() + 1);
+  }
+  int64_t elapsed = benchNow() - start;
+  uint64_t recomputes = graph.recomputes() - before;
+  benchRate(label, recomputes, elapsed);
+  std::printf("%-32s %.1f us per transaction, %.2f recomputes per node\n", "",
+    double(elapsed) / 1e3 / transactions, double(recomputes) / transactions / (nodes - 1));
+  uint64_t check = 0;
+  for (auto& n : second)
+  {
+    check ^= n->get();
+  }
+  benchKeep(check);
+  // nodes must go before the nodes they depend on
+  second.clear();
+  first.clear();
+}
+
+int main(int argc, char** argv)
+{
+  unsigned transactions = (argc > 1) ? unsigned(std::atoi(argv[1])) : 200;
+  unsigned work = (argc > 2) ? unsigned(std::atoi(argv[2])) : 100;
+  unsigned threads = (argc > 3) ? unsigned(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+  run("serial recomputes", nullptr, transactions, work);
+  WorkStealingPool pool(threads > 1 ? threads - 1 : 1);
+  run("pool recomputes", &pool, transactions, work);
+  return 0;
+}